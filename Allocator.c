@@ -0,0 +1,182 @@
+
+#include "Allocator.h"
+
+#include <stdlib.h>
+
+#ifdef AMIGA
+#include <exec/memory.h>
+#include <proto/exec.h>
+#endif
+
+// Allocations are aligned for SSE2 loads and stores
+enum { ArenaAlignment = 16 };
+
+struct ArenaBlock
+{
+	ArenaBlock* next;
+	size_t size;
+	size_t used;
+	size_t pad;
+};
+
+void* allocateMemory(const Allocator* allocator, size_t size)
+{
+	if (!allocator)
+		return malloc(size);
+	return allocator->allocate(allocator->context, size);
+}
+
+void releaseMemory(const Allocator* allocator, void* memory)
+{
+	if (!memory)
+		return;
+
+	if (!allocator)
+		free(memory);
+	else
+		allocator->release(allocator->context, memory);
+}
+
+static size_t alignArenaSize(size_t size)
+{
+	return (size + ArenaAlignment - 1) & ~(size_t) (ArenaAlignment - 1);
+}
+
+static uint8_t* getArenaBlockData(ArenaBlock* block)
+{
+	return (uint8_t*) block + alignArenaSize(sizeof(ArenaBlock));
+}
+
+// On AmigaOS the blocks come from exec rather than the C heap, which is not safe to use from a
+//  preload process and the display loop at the same time
+static ArenaBlock* allocateArenaBlockMemory(size_t size)
+{
+#ifdef AMIGA
+	return (ArenaBlock*) AllocVec(size, MEMF_ANY);
+#else
+	return (ArenaBlock*) malloc(size);
+#endif
+}
+
+static void releaseArenaBlockMemory(ArenaBlock* block)
+{
+#ifdef AMIGA
+	FreeVec(block);
+#else
+	free(block);
+#endif
+}
+
+static ArenaBlock* allocateArenaBlock(ArenaAllocator* arena, size_t size)
+{
+	ArenaBlock* block = allocateArenaBlockMemory(alignArenaSize(sizeof(ArenaBlock)) + size + ArenaAlignment);
+	if (!block)
+		return 0;
+
+	block->next = 0;
+	block->size = size;
+	block->used = 0;
+
+	// Neither malloc() nor AllocVec() promise 16-byte alignment
+	block->pad = (size_t) (-(uintptr_t) getArenaBlockData(block) & (ArenaAlignment - 1));
+	arena->stats.numBlockAllocations++;
+	return block;
+}
+
+static void* allocateFromArena(void* context, size_t size)
+{
+	ArenaAllocator* arena = (ArenaAllocator*) context;
+	size_t alignedSize = alignArenaSize(size ? size : 1);
+	ArenaBlock* block = arena->blocks;
+
+	if (!block || block->size - block->used < alignedSize)
+	{
+		// Start a new block; the remainder of the current one is left unused until the next reset
+		size_t blockSize = (alignedSize > arena->minBlockSize) ? alignedSize : arena->minBlockSize;
+		ArenaBlock* newBlock = allocateArenaBlock(arena, blockSize);
+		if (!newBlock)
+			return 0;
+
+		newBlock->next = block;
+		arena->blocks = block = newBlock;
+	}
+
+	void* memory = getArenaBlockData(block) + block->pad + block->used;
+	block->used += alignedSize;
+
+	arena->lastAllocation = memory;
+	arena->lastAllocationSize = alignedSize;
+
+	arena->stats.numAllocations++;
+	arena->stats.totalBytes += size;
+	arena->stats.currentBytes += alignedSize;
+	if (arena->stats.currentBytes > arena->stats.peakBytes)
+		arena->stats.peakBytes = arena->stats.currentBytes;
+
+	return memory;
+}
+
+static void releaseToArena(void* context, void* memory)
+{
+	ArenaAllocator* arena = (ArenaAllocator*) context;
+
+	if (memory != arena->lastAllocation)
+		return;
+
+	arena->blocks->used -= arena->lastAllocationSize;
+	arena->stats.currentBytes -= arena->lastAllocationSize;
+	arena->lastAllocation = 0;
+}
+
+static void freeArenaBlocks(ArenaBlock* block)
+{
+	while (block)
+	{
+		ArenaBlock* next = block->next;
+		releaseArenaBlockMemory(block);
+		block = next;
+	}
+}
+
+void initArenaAllocator(ArenaAllocator* arena, size_t minBlockSize)
+{
+	arena->allocator.allocate = allocateFromArena;
+	arena->allocator.release = releaseToArena;
+	arena->allocator.context = arena;
+	arena->blocks = 0;
+	arena->minBlockSize = minBlockSize ? alignArenaSize(minBlockSize) : DefaultArenaBlockSize;
+	arena->lastAllocation = 0;
+	arena->lastAllocationSize = 0;
+	arena->stats = (AllocatorStats) { 0 };
+}
+
+void resetArenaAllocator(ArenaAllocator* arena)
+{
+	ArenaBlock* block = arena->blocks;
+
+	if (block && block->next)
+	{
+		// Replace the chain with a single block big enough for all of it, so that the next
+		//  round of the same size fits without going to the heap
+		size_t totalSize = 0;
+		for (ArenaBlock* chainBlock = block; chainBlock; chainBlock = chainBlock->next)
+			totalSize += chainBlock->size;
+
+		freeArenaBlocks(block);
+		arena->blocks = block = allocateArenaBlock(arena, totalSize);
+	}
+
+	if (block)
+		block->used = 0;
+
+	arena->lastAllocation = 0;
+	arena->stats.currentBytes = 0;
+}
+
+void freeArenaAllocator(ArenaAllocator* arena)
+{
+	freeArenaBlocks(arena->blocks);
+	arena->blocks = 0;
+	arena->lastAllocation = 0;
+	arena->stats.currentBytes = 0;
+}
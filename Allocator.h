@@ -0,0 +1,56 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include "Types.h"
+
+#include <stddef.h>
+
+// Where the parser and image loader get their memory from. A null Allocator pointer means
+//  the C heap. An allocator is only ever called on the thread which is loading.
+
+typedef struct
+{
+	void* (*allocate)(void* context, size_t size);
+	void (*release)(void* context, void* memory);
+	void* context;
+} Allocator;
+
+void* allocateMemory(const Allocator* allocator, size_t size);
+void releaseMemory(const Allocator* allocator, void* memory);
+
+typedef struct
+{
+	uint numAllocations;
+	size_t totalBytes;	// Sum of all allocation sizes since the allocator was created
+	size_t currentBytes;
+	size_t peakBytes;	// Highest currentBytes since the allocator was created
+	uint numBlockAllocations;	// How many times the allocator itself had to go to the C heap
+} AllocatorStats;
+
+typedef struct ArenaBlock ArenaBlock;
+
+// A bump allocator which hands out memory from large blocks, and takes it all back at once when
+//  reset. Releasing the most recent allocation returns its memory right away; any other release
+//  is deferred to the next reset. Blocks are kept across resets, so once the arena has grown to
+//  fit the largest load, loads no longer touch the C heap at all.
+typedef struct
+{
+	Allocator allocator;	// Hand &arena->allocator to the loader
+	ArenaBlock* blocks;	// The block being allocated from comes first
+	size_t minBlockSize;
+	void* lastAllocation;
+	size_t lastAllocationSize;
+	AllocatorStats stats;
+} ArenaAllocator;
+
+enum { DefaultArenaBlockSize = 256 * 1024 };
+
+void initArenaAllocator(ArenaAllocator* arena, size_t minBlockSize);
+
+// Makes all memory handed out so far available again; nothing allocated from the arena may be
+//  used afterwards. When the previous round needed several blocks, they are merged into one.
+void resetArenaAllocator(ArenaAllocator* arena);
+
+void freeArenaAllocator(ArenaAllocator* arena);
+
+#endif
@@ -0,0 +1,53 @@
+
+#include "Benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int compareTicks(const void* a_, const void* b_)
+{
+	TimerTicks a = *(const TimerTicks*) a_;
+	TimerTicks b = *(const TimerTicks*) b_;
+	return (a > b) - (a < b);
+}
+
+bool runBenchmarkStep(const BenchmarkSettings* settings, BenchmarkStepFunc step, void* context, BenchmarkSummary* summary)
+{
+	uint numRepeats = settings->numRepeats ? settings->numRepeats : 1;
+	TimerTicks* samples = (TimerTicks*) malloc(numRepeats * sizeof(TimerTicks));
+	if (!samples)
+		return false;
+
+	for (uint warmup = 0; warmup < settings->numWarmups; ++warmup)
+		step(context);
+
+	for (uint repeat = 0; repeat < numRepeats; ++repeat)
+	{
+		TimerTicks start = readTimer();
+		step(context);
+		samples[repeat] = readTimer() - start;
+	}
+
+	qsort(samples, numRepeats, sizeof(TimerTicks), compareTicks);
+
+	// The 99th percentile is the smallest sample which at least 99% of the samples do not exceed
+	uint p99Index = (numRepeats * 99 + 99) / 100 - 1;
+
+	summary->numSamples = numRepeats;
+	summary->minMicroseconds = timerTicksToMicroseconds(samples[0]);
+	summary->medianMicroseconds = timerTicksToMicroseconds(samples[numRepeats / 2]);
+	summary->p99Microseconds = timerTicksToMicroseconds(samples[p99Index]);
+
+	free(samples);
+	return true;
+}
+
+void printBenchmarkHeader(void)
+{
+	printf("  %-24s %12s %12s %12s\n", "(microseconds)", "min", "median", "p99");
+}
+
+void printBenchmarkSummary(const char* name, const BenchmarkSummary* summary)
+{
+	printf("  %-24s %12.1f %12.1f %12.1f\n", name, summary->minMicroseconds, summary->medianMicroseconds, summary->p99Microseconds);
+}
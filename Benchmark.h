@@ -0,0 +1,36 @@
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "Types.h"
+#include "Timer.h"
+
+// Runs a step of work over and over, and reports the fastest, median and 99th percentile time of
+//  one run. initTimer() must have succeeded first.
+
+typedef void (*BenchmarkStepFunc)(void* context);
+
+typedef struct
+{
+	uint numWarmups;	// Runs before timing starts, to fill caches and settle allocators
+	uint numRepeats;	// Timed runs
+} BenchmarkSettings;
+
+enum { DefaultBenchmarkWarmups = 3 };
+enum { DefaultBenchmarkRepeats = 50 };
+
+typedef struct
+{
+	uint numSamples;
+	double minMicroseconds;
+	double medianMicroseconds;
+	double p99Microseconds;
+} BenchmarkSummary;
+
+// Times each run of step on its own. Returns false on out-of-memory.
+bool runBenchmarkStep(const BenchmarkSettings* settings, BenchmarkStepFunc step, void* context, BenchmarkSummary* summary);
+
+void printBenchmarkHeader(void);
+void printBenchmarkSummary(const char* name, const BenchmarkSummary* summary);
+
+#endif
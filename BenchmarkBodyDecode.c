@@ -0,0 +1,237 @@
+#include "FileList.h"
+#include "Ilbm.h"
+#include "parseIff.h"
+#include "Timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Times loading images from memory, so that BODY decoding dominates, and sums the times up per
+//  kind of BODY: format, compression, depth, mask plane, and planar or chunky output
+
+enum { DefaultRepeats = 20 };
+enum { MaxCombinations = 64 };
+
+typedef struct
+{
+	bool isPbm;
+	uint depth;
+	bool hasMaskPlane;
+	bool compressed;
+} BodyFormat;
+
+typedef struct
+{
+	BodyFormat format;
+	bool chunkyOutput;
+	uint numImages;
+	uint64_t numPixels;
+	TimerTicks ticks;
+} Combination;
+
+static Combination s_combinations[MaxCombinations];
+static uint s_numCombinations = 0;
+
+static void parseErrorCallback(void* context, const IffErrorLocation* location, const char* message)
+{
+	char where[512];
+	formatIffErrorLocation(where, sizeof where, location);
+	printf("Error: %s (%s)\n", message, where);
+}
+
+static bool handleILBM(void* format_, void* buffer, unsigned int size)
+{
+	((BodyFormat*) format_)->isPbm = false;
+	return true;
+}
+
+static bool handlePBM(void* format_, void* buffer, unsigned int size)
+{
+	((BodyFormat*) format_)->isPbm = true;
+	return true;
+}
+
+static bool handleBMHD(void* format_, void* buffer, unsigned int size)
+{
+	BodyFormat* format = (BodyFormat*) format_;
+	const uint8_t* header = (const uint8_t*) buffer;
+	if (size < 11)
+		return false;
+
+	format->depth = header[8];
+	format->hasMaskPlane = (header[9] == 1);
+	format->compressed = (header[10] == 1);
+	return true;
+}
+
+static bool readBodyFormat(const void* data, size_t size, BodyFormat* format)
+{
+	static const IffChunkHandler chunkHandlers[] = {
+		{ ID_ILBM, handleILBM },
+		{ ID_PBM, handlePBM },
+		{ ID_BMHD, handleBMHD },
+		{ 0, 0 },
+	};
+	IffParseRules parseRules = { 0 };
+	parseRules.errorFunc = parseErrorCallback;
+	parseRules.chunkHandlers = chunkHandlers;
+	parseRules.chunkHandlerState = format;
+
+	return parseIffMemory(data, size, &parseRules);
+}
+
+static Combination* findCombination(const BodyFormat* format, bool chunkyOutput)
+{
+	for (uint index = 0; index < s_numCombinations; ++index)
+	{
+		Combination* combination = &s_combinations[index];
+		if (!memcmp(&combination->format, format, sizeof *format) && combination->chunkyOutput == chunkyOutput)
+			return combination;
+	}
+
+	if (s_numCombinations == MaxCombinations)
+		return 0;
+
+	Combination* combination = &s_combinations[s_numCombinations++];
+	memset(combination, 0, sizeof *combination);
+	combination->format = *format;
+	combination->chunkyOutput = chunkyOutput;
+	return combination;
+}
+
+static void* readFile(const char* fileName, size_t* size)
+{
+	FILE* fileHandle = fopen(fileName, "rb");
+	if (!fileHandle)
+		return 0;
+
+	long fileSize = -1;
+	if (!fseek(fileHandle, 0, SEEK_END))
+		fileSize = ftell(fileHandle);
+
+	void* data = (fileSize > 0 && !fseek(fileHandle, 0, SEEK_SET)) ? malloc(fileSize) : 0;
+	if (data && fread(data, fileSize, 1, fileHandle) != 1)
+	{
+		free(data);
+		data = 0;
+	}
+
+	fclose(fileHandle);
+	*size = (size_t) fileSize;
+	return data;
+}
+
+static bool benchmarkFile(const char* fileName, uint repeats)
+{
+	size_t size;
+	void* data = readFile(fileName, &size);
+	BodyFormat format;
+	memset(&format, 0, sizeof format);
+
+	if (!data || !readBodyFormat(data, size, &format))
+	{
+		printf("Unable to read %s\n", fileName);
+		free(data);
+		return false;
+	}
+
+	for (uint output = 0; output < 2; ++output)
+	{
+		LoadIffImageOptions options = { 0 };
+		options.chunkyOutput = (output == 1);
+
+		TimerTicks fastest = 0;
+		Ilbm* ilbm = 0;
+		for (uint repeat = 0; repeat < repeats; ++repeat)
+		{
+			TimerTicks start = readTimer();
+			ilbm = loadIffImageFromMemoryWithOptions(data, size, &options, parseErrorCallback, 0);
+			TimerTicks elapsed = readTimer() - start;
+
+			if (!ilbm)
+			{
+				free(data);
+				return false;
+			}
+
+			if (!repeat || elapsed < fastest)
+				fastest = elapsed;
+
+			if (repeat != repeats - 1)
+				freeIlbm(ilbm);
+		}
+
+		Combination* combination = findCombination(&format, options.chunkyOutput);
+		if (combination)
+		{
+			combination->numImages++;
+			combination->numPixels += ilbm->width * ilbm->height;
+			combination->ticks += fastest;
+		}
+		freeIlbm(ilbm);
+	}
+
+	free(data);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	uint repeats = DefaultRepeats;
+
+	if (argc > 3 && !strcmp(argv[1], "-repeats"))
+	{
+		repeats = (uint) atoi(argv[2]);
+		argv += 2;
+		argc -= 2;
+	}
+
+	if (argc < 2 || !repeats)
+	{
+		printf("usage: BenchmarkBodyDecode [-repeats <count>] <file or directory> [more files or directories...]\n");
+		return 0;
+	}
+
+	FileList fileList = { 0 };
+	for (int arg = 1; arg < argc; ++arg)
+		if (!addFileOrDirectory(&fileList, argv[arg]))
+		{
+			printf("Unable to read %s\n", argv[arg]);
+			freeFileList(&fileList);
+			return -1;
+		}
+
+	if (!initTimer())
+	{
+		printf("Unable to open timer\n");
+		freeFileList(&fileList);
+		return -1;
+	}
+
+	bool failed = false;
+	for (uint file = 0; file < fileList.numFiles; ++file)
+		if (!benchmarkFile(fileList.fileNames[file], repeats))
+			failed = true;
+
+	printf("Fastest of %u loads, summed per kind of BODY:\n", repeats);
+	for (uint index = 0; index < s_numCombinations; ++index)
+	{
+		const Combination* combination = &s_combinations[index];
+		double microseconds = timerTicksToMicroseconds(combination->ticks);
+
+		printf("  %-4s %-4s %u planes%-6s -> %-6s: %u images, %9.1f us, %6.2f ns/pixel\n",
+			combination->format.isPbm ? "PBM" : "ILBM",
+			combination->format.compressed ? "RLE" : "raw",
+			combination->format.depth,
+			combination->format.hasMaskPlane ? "+mask" : "",
+			combination->chunkyOutput ? "chunky" : "planar",
+			combination->numImages,
+			microseconds,
+			combination->numPixels ? microseconds * 1000.0 / combination->numPixels : 0.0);
+	}
+
+	shutdownTimer();
+	freeFileList(&fileList);
+	return failed ? -1 : 0;
+}
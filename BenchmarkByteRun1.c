@@ -0,0 +1,263 @@
+#include "ByteRun1.h"
+#include "FileList.h"
+#include "parseIff.h"
+#include "Timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Times decodeByteRun1() against the byte-at-a-time decoder which the image loader used to have,
+//  on the BODY of every compressed image given, and checks that both produce the same pixels
+
+enum { DefaultRepeats = 20 };
+
+typedef struct
+{
+	const char* fileName;
+	bool isPbm;
+	uint width;
+	uint height;
+	uint depth;
+	bool hasMaskPlane;
+	bool compressed;
+	uint8_t* body;
+	uint bodySize;
+} BenchmarkImage;
+
+static void parseErrorCallback(void* context, const IffErrorLocation* location, const char* message)
+{
+	char where[512];
+	formatIffErrorLocation(where, sizeof where, location);
+	printf("Error: %s (%s)\n", message, where);
+}
+
+static bool handleILBM(void* image_, void* buffer, unsigned int size)
+{
+	((BenchmarkImage*) image_)->isPbm = false;
+	return true;
+}
+
+static bool handlePBM(void* image_, void* buffer, unsigned int size)
+{
+	((BenchmarkImage*) image_)->isPbm = true;
+	return true;
+}
+
+static bool handleBMHD(void* image_, void* buffer, unsigned int size)
+{
+	BenchmarkImage* image = (BenchmarkImage*) image_;
+	const uint8_t* header = (const uint8_t*) buffer;
+	if (size < 11)
+		return false;
+
+	image->width = readIffUint16(header + 0);
+	image->height = readIffUint16(header + 2);
+	image->depth = header[8];
+	image->hasMaskPlane = (header[9] == 1);
+	image->compressed = (header[10] == 1);
+	return true;
+}
+
+static bool handleBODY(void* image_, void* buffer, unsigned int size)
+{
+	BenchmarkImage* image = (BenchmarkImage*) image_;
+	if (image->body || !(image->body = malloc(size ? size : 1)))
+		return !!image->body;
+
+	memcpy(image->body, buffer, size);
+	image->bodySize = size;
+	return true;
+}
+
+// The decoder as it was before decodeByteRun1(): one byte at a time, trusting the source
+static uint referenceDecodeRLE(uint8_t* dest, const uint8_t* src, uint destBytes)
+{
+	const uint8_t* srcStart = src;
+	uint8_t* destEnd = dest + destBytes;
+
+	while (dest != destEnd)
+	{
+		int8_t count = *src++;
+		if (count >= 0)
+		{
+			while (count-- != -1)
+				*dest++ = *src++;
+		}
+		else if (count != -128)
+		{
+			uint8_t value = *src++;
+			while (count++ != 1)
+				*dest++ = value;
+		}
+	}
+
+	return src - srcStart;
+}
+
+static uint getRowPartBytes(const BenchmarkImage* image)
+{
+	return image->isPbm ? image->width : ((image->width + 15) / 16) * 2;
+}
+
+static uint getNumRowParts(const BenchmarkImage* image)
+{
+	return image->height * (image->isPbm ? 1 : image->depth + (image->hasMaskPlane ? 1 : 0));
+}
+
+static bool decodeWithReference(const BenchmarkImage* image, uint8_t* dest)
+{
+	uint rowPartBytes = getRowPartBytes(image);
+	uint numRowParts = getNumRowParts(image);
+	uint offset = 0;
+
+	for (uint rowPart = 0; rowPart < numRowParts; ++rowPart)
+		offset += referenceDecodeRLE(dest + rowPart * rowPartBytes, image->body + offset, rowPartBytes);
+
+	return offset == image->bodySize;
+}
+
+static bool decodeWithByteRun1(const BenchmarkImage* image, uint8_t* dest)
+{
+	uint rowPartBytes = getRowPartBytes(image);
+	uint numRowParts = getNumRowParts(image);
+	const uint8_t* source = image->body;
+	const uint8_t* sourceEnd = image->body + image->bodySize;
+
+	for (uint rowPart = 0; rowPart < numRowParts; ++rowPart)
+		if (!(source = decodeByteRun1(dest + rowPart * rowPartBytes, rowPartBytes, source, sourceEnd)))
+			return false;
+
+	return source == sourceEnd;
+}
+
+static TimerTicks timeDecoder(bool (*decode)(const BenchmarkImage*, uint8_t*), const BenchmarkImage* image, uint8_t* dest, uint repeats)
+{
+	TimerTicks fastest = 0;
+
+	for (uint repeat = 0; repeat < repeats; ++repeat)
+	{
+		TimerTicks start = readTimer();
+		decode(image, dest);
+		TimerTicks elapsed = readTimer() - start;
+
+		if (!repeat || elapsed < fastest)
+			fastest = elapsed;
+	}
+
+	return fastest;
+}
+
+static bool benchmarkFile(const char* fileName, uint repeats, TimerTicks* referenceTotal, TimerTicks* byteRun1Total)
+{
+	static const IffChunkHandler chunkHandlers[] = {
+		{ ID_ILBM, handleILBM },
+		{ ID_PBM, handlePBM },
+		{ ID_BMHD, handleBMHD },
+		{ ID_BODY, handleBODY },
+		{ 0, 0 },
+	};
+	BenchmarkImage image = { 0 };
+	IffParseRules parseRules = { 0 };
+	parseRules.errorFunc = parseErrorCallback;
+	parseRules.chunkHandlers = chunkHandlers;
+	parseRules.chunkHandlerState = &image;
+
+	if (!parseIffMapped(fileName, &parseRules) || !image.body)
+	{
+		free(image.body);
+		return false;
+	}
+
+	if (!image.compressed)
+	{
+		printf("%s: not compressed, skipped\n", fileName);
+		free(image.body);
+		return true;
+	}
+
+	uint decodedBytes = getNumRowParts(&image) * getRowPartBytes(&image);
+	uint8_t* referencePixels = malloc(decodedBytes);
+	uint8_t* byteRun1Pixels = malloc(decodedBytes);
+	bool result = false;
+
+	// The reference decoder does not check its input, so it only gets to see BODYs which pass the new one
+	if (referencePixels && byteRun1Pixels)
+	{
+		if (!decodeWithByteRun1(&image, byteRun1Pixels))
+			printf("%s: malformed BODY, skipped\n", fileName);
+		else if (!decodeWithReference(&image, referencePixels) || memcmp(referencePixels, byteRun1Pixels, decodedBytes))
+			printf("%s: decoders disagree\n", fileName);
+		else
+		{
+			TimerTicks referenceTicks = timeDecoder(decodeWithReference, &image, referencePixels, repeats);
+			TimerTicks byteRun1Ticks = timeDecoder(decodeWithByteRun1, &image, byteRun1Pixels, repeats);
+			double referenceMicroseconds = timerTicksToMicroseconds(referenceTicks);
+			double byteRun1Microseconds = timerTicksToMicroseconds(byteRun1Ticks);
+
+			printf("%s: %ux%ux%u %s, %u -> %u bytes: byte loop %.1f us, ByteRun1 %.1f us (%.2fx)\n", fileName,
+				image.width, image.height, image.depth, image.isPbm ? "PBM" : "ILBM", image.bodySize, decodedBytes,
+				referenceMicroseconds, byteRun1Microseconds, byteRun1Microseconds > 0.0 ? referenceMicroseconds / byteRun1Microseconds : 0.0);
+
+			*referenceTotal += referenceTicks;
+			*byteRun1Total += byteRun1Ticks;
+			result = true;
+		}
+	}
+
+	free(referencePixels);
+	free(byteRun1Pixels);
+	free(image.body);
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	uint repeats = DefaultRepeats;
+
+	if (argc > 3 && !strcmp(argv[1], "-repeats"))
+	{
+		repeats = (uint) atoi(argv[2]);
+		argv += 2;
+		argc -= 2;
+	}
+
+	if (argc < 2 || !repeats)
+	{
+		printf("usage: BenchmarkByteRun1 [-repeats <count>] <file or directory> [more files or directories...]\n");
+		return 0;
+	}
+
+	FileList fileList = { 0 };
+	for (int arg = 1; arg < argc; ++arg)
+		if (!addFileOrDirectory(&fileList, argv[arg]))
+		{
+			printf("Unable to read %s\n", argv[arg]);
+			freeFileList(&fileList);
+			return -1;
+		}
+
+	if (!initTimer())
+	{
+		printf("Unable to open timer\n");
+		freeFileList(&fileList);
+		return -1;
+	}
+
+	TimerTicks referenceTotal = 0;
+	TimerTicks byteRun1Total = 0;
+	bool failed = false;
+
+	for (uint file = 0; file < fileList.numFiles; ++file)
+		if (!benchmarkFile(fileList.fileNames[file], repeats, &referenceTotal, &byteRun1Total))
+			failed = true;
+
+	if (byteRun1Total)
+		printf("Total, fastest of %u runs: byte loop %.1f us, ByteRun1 %.1f us (%.2fx)\n", repeats,
+			timerTicksToMicroseconds(referenceTotal), timerTicksToMicroseconds(byteRun1Total),
+			(double) referenceTotal / (double) byteRun1Total);
+
+	shutdownTimer();
+	freeFileList(&fileList);
+	return failed ? -1 : 0;
+}
@@ -0,0 +1,480 @@
+
+#include "Benchmark.h"
+#include "ByteRun1.h"
+#include "ChunkyToPlanar.h"
+#include "FileList.h"
+#include "Ilbm.h"
+#include "PaletteAnimation.h"
+#include "PlanarToChunky.h"
+#include "ScreenAndInput.h"
+#include "SyntheticImage.h"
+#include "parseIff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Times each step from an IFF file to colors cycling on screen: reading the file, walking its
+//  chunks, decoding BODY, converting between planar and chunky pixels, whole loads, moving the image
+//  to the screen, and computing the palette of a frame. The decode and conversion steps are timed
+//  on their own outside of the loader, so that they can be told apart from its overhead.
+
+static const SyntheticImageParams s_syntheticImages[] = {
+	// width, height, depth, pbm, compressed, runLength, numColorRanges, seed
+	{ 320, 256, 4, false, true, 8, 4, 1 },
+	{ 320, 256, 5, false, true, 8, 4, 1 },
+	{ 320, 256, 8, false, true, 8, 16, 1 },
+	{ 320, 256, 8, false, true, 1, 16, 1 },
+	{ 320, 256, 8, false, false, 8, 16, 1 },
+	{ 640, 512, 8, false, true, 32, 16, 1 },
+	{ 320, 256, 8, true, true, 8, 16, 1 },
+	{ 640, 512, 8, true, true, 32, 16, 1 },
+};
+
+typedef struct
+{
+	const char* fileName;	// 0 for synthetic images
+	const uint8_t* data;
+	size_t size;
+	uint8_t* readBuffer;
+
+	bool isPbm;
+	uint width;
+	uint height;
+	uint depth;
+	bool hasMaskPlane;
+	bool compressed;
+	uint8_t* body;
+	uint bodySize;
+
+	// BODY decoded by the benchmark itself: all planes of a row after each other, or zero-padded
+	//  chunky rows for PBM
+	uint bytesPerRow;
+	uint8_t* planes;
+	uint8_t* chunky;
+	uint chunkyPitch;
+	ChunkyToPlanarRowFunc chunkyToPlanarRow;
+	PlanarToChunkyRowFunc planarToChunkyRow;
+
+	Ilbm* ilbm;
+	PaletteAnimation* animation;
+	uint frame;
+	bool blend;
+	bool chunkyOutput;
+} BenchmarkImage;
+
+static void parseErrorCallback(void* context, const IffErrorLocation* location, const char* message)
+{
+	char where[512];
+	formatIffErrorLocation(where, sizeof where, location);
+	printf("Error: %s (%s)\n", message, where);
+}
+
+static bool handleAnyChunk(void* image_, void* buffer, unsigned int size)
+{
+	return true;
+}
+
+static bool handleILBM(void* image_, void* buffer, unsigned int size)
+{
+	((BenchmarkImage*) image_)->isPbm = false;
+	return true;
+}
+
+static bool handlePBM(void* image_, void* buffer, unsigned int size)
+{
+	((BenchmarkImage*) image_)->isPbm = true;
+	return true;
+}
+
+static bool handleBMHD(void* image_, void* buffer, unsigned int size)
+{
+	BenchmarkImage* image = (BenchmarkImage*) image_;
+	const uint8_t* header = (const uint8_t*) buffer;
+	if (size < 11)
+		return false;
+
+	image->width = readIffUint16(header + 0);
+	image->height = readIffUint16(header + 2);
+	image->depth = header[8];
+	image->hasMaskPlane = (header[9] == 1);
+	image->compressed = (header[10] == 1);
+	return true;
+}
+
+static bool handleBODY(void* image_, void* buffer, unsigned int size)
+{
+	BenchmarkImage* image = (BenchmarkImage*) image_;
+	if (!(image->body = (uint8_t*) malloc(size)))
+		return false;
+
+	memcpy(image->body, buffer, size);
+	image->bodySize = size;
+	return true;
+}
+
+static void readFileStep(void* image_)
+{
+	BenchmarkImage* image = (BenchmarkImage*) image_;
+	FILE* fileHandle = fopen(image->fileName, "rb");
+	if (!fileHandle)
+		return;
+
+	if (fread(image->readBuffer, image->size, 1, fileHandle) != 1)
+		printf("Unable to read %s\n", image->fileName);
+	fclose(fileHandle);
+}
+
+static void parseIffStep(void* image_)
+{
+	BenchmarkImage* image = (BenchmarkImage*) image_;
+	static const IffChunkHandler chunkHandlers[] = {
+		{ ID_ILBM, handleAnyChunk },
+		{ ID_PBM, handleAnyChunk },
+		{ ID_BMHD, handleAnyChunk },
+		{ ID_CMAP, handleAnyChunk },
+		{ ID_CAMG, handleAnyChunk },
+		{ ID_CRNG, handleAnyChunk },
+		{ ID_BODY, handleAnyChunk },
+		{ 0, 0 },
+	};
+	IffParseRules parseRules = { 0 };
+	parseRules.errorFunc = parseErrorCallback;
+	parseRules.chunkHandlers = chunkHandlers;
+
+	parseIffMemory(image->data, image->size, &parseRules);
+}
+
+static const uint8_t* decodeRowPart(uint8_t* dest, uint bytes, const uint8_t* source, const uint8_t* sourceEnd, bool compressed)
+{
+	if (compressed)
+		return dest ? decodeByteRun1(dest, bytes, source, sourceEnd) : skipByteRun1(bytes, source, sourceEnd);
+
+	if (bytes > (uint) (sourceEnd - source))
+		return 0;
+	if (dest)
+		memcpy(dest, source, bytes);
+	return source + bytes;
+}
+
+static bool decodeBody(BenchmarkImage* image)
+{
+	const uint8_t* source = image->body;
+	const uint8_t* sourceEnd = source + image->bodySize;
+
+	for (uint row = 0; row < image->height; ++row)
+	{
+		if (image->isPbm)
+		{
+			if (!(source = decodeRowPart(image->chunky + row * image->chunkyPitch, image->width, source, sourceEnd, image->compressed)))
+				return false;
+			continue;
+		}
+
+		uint8_t* rowPlanes = image->planes + row * image->depth * image->bytesPerRow;
+		for (uint plane = 0; plane < image->depth; ++plane)
+			if (!(source = decodeRowPart(rowPlanes + plane * image->bytesPerRow, image->bytesPerRow, source, sourceEnd, image->compressed)))
+				return false;
+
+		if (image->hasMaskPlane && !(source = decodeRowPart(0, image->bytesPerRow, source, sourceEnd, image->compressed)))
+			return false;
+	}
+
+	return true;
+}
+
+static void decodeBodyStep(void* image_)
+{
+	decodeBody((BenchmarkImage*) image_);
+}
+
+static void convertStep(void* image_)
+{
+	BenchmarkImage* image = (BenchmarkImage*) image_;
+	uint8_t* planeRows[MaxIlbmPlanes];
+
+	for (uint row = 0; row < image->height; ++row)
+	{
+		uint8_t* rowPlanes = image->planes + row * image->depth * image->bytesPerRow;
+		uint8_t* chunkyRow = image->chunky + row * image->chunkyPitch;
+		for (uint plane = 0; plane < image->depth; ++plane)
+			planeRows[plane] = rowPlanes + plane * image->bytesPerRow;
+
+		if (image->isPbm)
+			image->chunkyToPlanarRow(chunkyRow, image->width, planeRows);
+		else
+			image->planarToChunkyRow((const uint8_t* const*) planeRows, image->width, chunkyRow);
+	}
+}
+
+static void loadStep(void* image_)
+{
+	BenchmarkImage* image = (BenchmarkImage*) image_;
+	LoadIffImageOptions options = { 0 };
+	options.chunkyOutput = image->chunkyOutput;
+
+	Ilbm* ilbm = loadIffImageFromMemoryWithOptions(image->data, image->size, &options, parseErrorCallback, 0);
+	if (ilbm)
+		freeIlbm(ilbm);
+}
+
+static void copyImageToScreenStep(void* image_)
+{
+	copyImageToScreen(((BenchmarkImage*) image_)->ilbm);
+}
+
+static void animatePaletteStep(void* image_)
+{
+	BenchmarkImage* image = (BenchmarkImage*) image_;
+	animatePalette(image->animation, image->frame, image->blend);
+	image->frame += 1 << 16;
+}
+
+static bool runStep(const char* name, const BenchmarkSettings* settings, BenchmarkStepFunc step, BenchmarkImage* image)
+{
+	BenchmarkSummary summary;
+	if (!runBenchmarkStep(settings, step, image, &summary))
+	{
+		printf("Out of memory\n");
+		return false;
+	}
+
+	printBenchmarkSummary(name, &summary);
+	return true;
+}
+
+static bool prepareImage(BenchmarkImage* image)
+{
+	static const IffChunkHandler chunkHandlers[] = {
+		{ ID_ILBM, handleILBM },
+		{ ID_PBM, handlePBM },
+		{ ID_BMHD, handleBMHD },
+		{ ID_BODY, handleBODY },
+		{ 0, 0 },
+	};
+	IffParseRules parseRules = { 0 };
+	parseRules.errorFunc = parseErrorCallback;
+	parseRules.chunkHandlers = chunkHandlers;
+	parseRules.chunkHandlerState = image;
+
+	if (!parseIffMemory(image->data, image->size, &parseRules) || !image->body
+		|| !image->depth || image->depth > MaxIlbmPlanes)
+		return false;
+
+	image->bytesPerRow = ((image->width + 15) / 16) * 2;
+	image->chunkyPitch = image->bytesPerRow * 8;
+	image->planes = (uint8_t*) malloc(image->height * image->depth * image->bytesPerRow);
+	image->chunky = (uint8_t*) calloc(image->height, image->chunkyPitch);
+	image->chunkyToPlanarRow = selectChunkyToPlanarRowFunc(image->depth);
+	image->planarToChunkyRow = selectPlanarToChunkyRowFunc(image->depth);
+	if (!image->planes || !image->chunky || !decodeBody(image))
+		return false;
+
+	if (!(image->ilbm = loadIffImageFromMemory(image->data, image->size, parseErrorCallback, 0))
+		|| !(image->animation = createPaletteAnimation(image->ilbm)))
+		return false;
+
+	return true;
+}
+
+static void freeImage(BenchmarkImage* image)
+{
+	if (image->animation)
+		freePaletteAnimation(image->animation);
+	if (image->ilbm)
+		freeIlbm(image->ilbm);
+	free(image->readBuffer);
+	free(image->body);
+	free(image->planes);
+	free(image->chunky);
+}
+
+static bool benchmarkImage(BenchmarkImage* image, const char* description, const BenchmarkSettings* settings)
+{
+	if (!prepareImage(image))
+	{
+		printf("Unable to benchmark %s\n", description);
+		return false;
+	}
+
+	printf("%s: %s %ux%ux%u%s %s, %u color ranges\n", description, image->isPbm ? "PBM" : "ILBM",
+		image->width, image->height, image->depth, image->hasMaskPlane ? "+mask" : "",
+		image->compressed ? "RLE" : "raw", image->ilbm->numColorRanges);
+	printBenchmarkHeader();
+
+	bool succeeded = true;
+	if (image->fileName)
+	{
+		if ((image->readBuffer = (uint8_t*) malloc(image->size)))
+			succeeded = runStep("read file", settings, readFileStep, image);
+	}
+
+	succeeded = succeeded
+		&& runStep("parseIff", settings, parseIffStep, image)
+		&& runStep(image->compressed ? "decode BODY (ByteRun1)" : "decode BODY (copy)", settings, decodeBodyStep, image)
+		&& runStep(image->isPbm ? "chunky to planar" : "planar to chunky", settings, convertStep, image);
+
+	image->chunkyOutput = false;
+	succeeded = succeeded && runStep("load, planar", settings, loadStep, image);
+	image->chunkyOutput = true;
+	succeeded = succeeded && runStep("load, chunky", settings, loadStep, image);
+
+	if (succeeded && openScreen(image->width, image->height, image->depth))
+	{
+		setPalette(image->ilbm->palette.numColors, image->ilbm->palette.colors);
+		succeeded = runStep("copyImageToScreen", settings, copyImageToScreenStep, image);
+		closeScreen();
+	}
+
+	image->blend = false;
+	succeeded = succeeded && runStep("animatePalette", settings, animatePaletteStep, image);
+	image->blend = true;
+	succeeded = succeeded && runStep("animatePalette, blend", settings, animatePaletteStep, image);
+
+	return succeeded;
+}
+
+static void* readFile(const char* fileName, size_t* size)
+{
+	FILE* fileHandle = fopen(fileName, "rb");
+	if (!fileHandle)
+		return 0;
+
+	long fileSize = -1;
+	if (!fseek(fileHandle, 0, SEEK_END))
+		fileSize = ftell(fileHandle);
+
+	void* data = (fileSize > 0 && !fseek(fileHandle, 0, SEEK_SET)) ? malloc(fileSize) : 0;
+	if (data && fread(data, fileSize, 1, fileHandle) != 1)
+	{
+		free(data);
+		data = 0;
+	}
+
+	fclose(fileHandle);
+	*size = (size_t) fileSize;
+	return data;
+}
+
+static bool benchmarkFile(const char* fileName, const BenchmarkSettings* settings)
+{
+	BenchmarkImage image;
+	memset(&image, 0, sizeof image);
+	image.fileName = fileName;
+
+	void* data = readFile(fileName, &image.size);
+	if (!data)
+	{
+		printf("Unable to read %s\n", fileName);
+		return false;
+	}
+
+	image.data = (const uint8_t*) data;
+	bool succeeded = benchmarkImage(&image, fileName, settings);
+	freeImage(&image);
+	free(data);
+	return succeeded;
+}
+
+static bool benchmarkSyntheticImage(const SyntheticImageParams* params, const BenchmarkSettings* settings)
+{
+	BenchmarkImage image;
+	memset(&image, 0, sizeof image);
+
+	char description[256];
+	sprintf(description, "synthetic, runs of %u pixels", params->runLength);
+
+	void* data = createSyntheticImage(params, &image.size);
+	if (!data)
+	{
+		printf("Unable to create %s image\n", description);
+		return false;
+	}
+
+	image.data = (const uint8_t*) data;
+	bool succeeded = benchmarkImage(&image, description, settings);
+	freeImage(&image);
+	free(data);
+	return succeeded;
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+	settings.numWarmups = DefaultBenchmarkWarmups;
+	settings.numRepeats = DefaultBenchmarkRepeats;
+	bool synthetic = false;
+
+	while (argc > 1 && argv[1][0] == '-')
+	{
+		if (argc > 2 && !strcmp(argv[1], "-warmup"))
+			settings.numWarmups = (uint) atoi(argv[2]);
+		else if (argc > 2 && !strcmp(argv[1], "-repeats"))
+			settings.numRepeats = (uint) atoi(argv[2]);
+		else if (!strcmp(argv[1], "-synthetic"))
+		{
+			synthetic = true;
+			argv++;
+			argc--;
+			continue;
+		}
+		else
+			break;
+
+		argv += 2;
+		argc -= 2;
+	}
+
+	if ((argc < 2 && !synthetic) || !settings.numRepeats)
+	{
+		printf("usage: BenchmarkLoadAndAnimate [-warmup <count>] [-repeats <count>] [-synthetic] [file or directory] [more files or directories...]\n");
+		return 0;
+	}
+
+	FileList fileList = { 0 };
+	for (int arg = 1; arg < argc; ++arg)
+		if (!addFileOrDirectory(&fileList, argv[arg]))
+		{
+			printf("Unable to read %s\n", argv[arg]);
+			freeFileList(&fileList);
+			return -1;
+		}
+
+	if (!initTimer())
+	{
+		printf("Unable to open timer\n");
+		freeFileList(&fileList);
+		return -1;
+	}
+
+	if (!initScreenAndInput())
+	{
+		printf("Unable to initialize screen\n");
+		shutdownTimer();
+		freeFileList(&fileList);
+		return -1;
+	}
+
+	printf("%u warm-up runs and %u timed runs per step\n\n", settings.numWarmups, settings.numRepeats);
+
+	bool failed = false;
+	for (uint file = 0; file < fileList.numFiles; ++file)
+	{
+		if (!benchmarkFile(fileList.fileNames[file], &settings))
+			failed = true;
+		printf("\n");
+	}
+
+	if (synthetic)
+		for (uint index = 0; index < sizeof s_syntheticImages / sizeof s_syntheticImages[0]; ++index)
+		{
+			if (!benchmarkSyntheticImage(&s_syntheticImages[index], &settings))
+				failed = true;
+			printf("\n");
+		}
+
+	shutdownScreenAndInput();
+	shutdownTimer();
+	freeFileList(&fileList);
+	return failed ? -1 : 0;
+}
@@ -0,0 +1,105 @@
+
+#include "ByteRun1.h"
+
+#include <string.h>
+
+// Short runs are the common case in detailed pictures, and for them a call to memcpy() or memset()
+//  costs more than the work itself. Where the row and the source have room to spare, runs are moved
+//  in whole blocks of ShortRunBytes instead; the overshoot stays within the row, and is overwritten
+//  by the runs which follow.
+enum { ShortRunBytes = 16 };
+
+static void copyShortRun(uint8_t* dest, const uint8_t* source)
+{
+	uint64_t words[2];
+	memcpy(words, source, sizeof words);
+	memcpy(dest, words, sizeof words);
+}
+
+static void fillShortRun(uint8_t* dest, uint8_t value)
+{
+	uint64_t words[2];
+	words[0] = words[1] = value * UINT64_C(0x0101010101010101);
+	memcpy(dest, words, sizeof words);
+}
+
+const uint8_t* decodeByteRun1(uint8_t* dest, uint destBytes, const uint8_t* source, const uint8_t* sourceEnd)
+{
+	uint8_t* destEnd = dest + destBytes;
+
+	while (dest != destEnd)
+	{
+		if (source == sourceEnd)
+			return 0;
+
+		int count = (int8_t) *source++;
+		uint destBytesLeft = destEnd - dest;
+		uint sourceBytesLeft = sourceEnd - source;
+
+		if (count >= 0)
+		{
+			uint runBytes = count + 1;
+			if (runBytes > destBytesLeft || runBytes > sourceBytesLeft)
+				return 0;
+
+			uint roundedRunBytes = (runBytes + ShortRunBytes - 1) & ~(ShortRunBytes - 1);
+			if (roundedRunBytes <= destBytesLeft && roundedRunBytes <= sourceBytesLeft)
+			{
+				for (uint offset = 0; offset < runBytes; offset += ShortRunBytes)
+					copyShortRun(dest + offset, source + offset);
+			}
+			else
+				memcpy(dest, source, runBytes);
+			dest += runBytes;
+			source += runBytes;
+		}
+		else if (count != -128)
+		{
+			uint runBytes = -count + 1;
+			if (runBytes > destBytesLeft || !sourceBytesLeft)
+				return 0;
+
+			uint8_t value = *source++;
+			uint roundedRunBytes = (runBytes + ShortRunBytes - 1) & ~(ShortRunBytes - 1);
+			if (roundedRunBytes <= destBytesLeft)
+			{
+				for (uint offset = 0; offset < runBytes; offset += ShortRunBytes)
+					fillShortRun(dest + offset, value);
+			}
+			else
+				memset(dest, value, runBytes);
+			dest += runBytes;
+		}
+	}
+
+	return source;
+}
+const uint8_t* skipByteRun1(uint destBytes, const uint8_t* source, const uint8_t* sourceEnd)
+{
+	while (destBytes)
+	{
+		if (source == sourceEnd)
+			return 0;
+
+		int count = (int8_t) *source++;
+
+		if (count >= 0)
+		{
+			uint runBytes = count + 1;
+			if (runBytes > destBytes || runBytes > (uint) (sourceEnd - source))
+				return 0;
+			source += runBytes;
+			destBytes -= runBytes;
+		}
+		else if (count != -128)
+		{
+			uint runBytes = -count + 1;
+			if (runBytes > destBytes || source == sourceEnd)
+				return 0;
+			source++;
+			destBytes -= runBytes;
+		}
+	}
+
+	return source;
+}
@@ -0,0 +1,16 @@
+#ifndef BYTERUN1_H
+#define BYTERUN1_H
+
+#include "Types.h"
+
+// ByteRun1 is the run-length encoding of ILBM and PBM BODY rows: a signed count byte n is followed
+//  by n + 1 bytes to copy (n >= 0), or by one byte to repeat -n + 1 times (n > -128); n = -128
+//  does nothing. Each plane of each row is encoded on its own.
+//
+// Both functions read nothing at or beyond sourceEnd, and reject runs which cross the end of
+//  the row; they return the first source byte after the row, or 0 if the data is malformed.
+
+const uint8_t* decodeByteRun1(uint8_t* dest, uint destBytes, const uint8_t* source, const uint8_t* sourceEnd);
+const uint8_t* skipByteRun1(uint destBytes, const uint8_t* source, const uint8_t* sourceEnd);
+
+#endif
@@ -0,0 +1,149 @@
+
+#include "ChunkyToPlanar.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define CHUNKYTOPLANAR_SSE2
+#include <emmintrin.h>
+#endif
+
+#define MERGE16(a, b, temp, shift, mask) \
+	temp = ((b >> shift) ^ a) & mask; \
+	a ^= temp; \
+	b ^= (temp << shift);
+
+// The kernels are instantiated once per depth. Planes above the depth are never stored,
+//  which lets the compiler drop the butterfly steps that only feed those planes.
+
+#define DEFINE_CHUNKYTOPLANAR_ROW_SCALAR(depth) \
+static void chunkyToPlanarRowScalar##depth(const uint8_t* chunky, uint numPixels, uint8_t* const* planeRows) \
+{ \
+	for (uint offset = 0; offset < numPixels; offset += 16) \
+	{ \
+		const uint8_t* pixels = chunky + offset; \
+		uint16_t p0 = (pixels[0] << 8) | pixels[1]; \
+		uint16_t p1 = (pixels[2] << 8) | pixels[3]; \
+		uint16_t p2 = (pixels[4] << 8) | pixels[5]; \
+		uint16_t p3 = (pixels[6] << 8) | pixels[7]; \
+		uint16_t p4 = (pixels[8] << 8) | pixels[9]; \
+		uint16_t p5 = (pixels[10] << 8) | pixels[11]; \
+		uint16_t p6 = (pixels[12] << 8) | pixels[13]; \
+		uint16_t p7 = (pixels[14] << 8) | pixels[15]; \
+		uint16_t temp; \
+		MERGE16(p0, p4, temp, 8, 0x00ff); \
+		MERGE16(p1, p5, temp, 8, 0x00ff); \
+		MERGE16(p2, p6, temp, 8, 0x00ff); \
+		MERGE16(p3, p7, temp, 8, 0x00ff); \
+		MERGE16(p0, p2, temp, 4, 0x0f0f); \
+		MERGE16(p1, p3, temp, 4, 0x0f0f); \
+		MERGE16(p4, p6, temp, 4, 0x0f0f); \
+		MERGE16(p5, p7, temp, 4, 0x0f0f); \
+		MERGE16(p0, p1, temp, 2, 0x3333); \
+		MERGE16(p2, p3, temp, 2, 0x3333); \
+		MERGE16(p4, p5, temp, 2, 0x3333); \
+		MERGE16(p6, p7, temp, 2, 0x3333); \
+		MERGE16(p0, p4, temp, 1, 0x5555); \
+		MERGE16(p1, p5, temp, 1, 0x5555); \
+		MERGE16(p2, p6, temp, 1, 0x5555); \
+		MERGE16(p3, p7, temp, 1, 0x5555); \
+		uint byteOffset = offset >> 3; \
+		STORE_PLANE_WORD(depth, 0, p7); \
+		STORE_PLANE_WORD(depth, 1, p3); \
+		STORE_PLANE_WORD(depth, 2, p6); \
+		STORE_PLANE_WORD(depth, 3, p2); \
+		STORE_PLANE_WORD(depth, 4, p5); \
+		STORE_PLANE_WORD(depth, 5, p1); \
+		STORE_PLANE_WORD(depth, 6, p4); \
+		STORE_PLANE_WORD(depth, 7, p0); \
+	} \
+}
+
+// Plane data is stored big-endian byte by byte, so the kernel works on either host byte order
+#define STORE_PLANE_WORD(depth, plane, word) \
+	if (depth > plane) \
+	{ \
+		planeRows[plane][byteOffset] = (uint8_t) (word >> 8); \
+		planeRows[plane][byteOffset + 1] = (uint8_t) word; \
+	}
+
+DEFINE_CHUNKYTOPLANAR_ROW_SCALAR(1)
+DEFINE_CHUNKYTOPLANAR_ROW_SCALAR(2)
+DEFINE_CHUNKYTOPLANAR_ROW_SCALAR(3)
+DEFINE_CHUNKYTOPLANAR_ROW_SCALAR(4)
+DEFINE_CHUNKYTOPLANAR_ROW_SCALAR(5)
+DEFINE_CHUNKYTOPLANAR_ROW_SCALAR(6)
+DEFINE_CHUNKYTOPLANAR_ROW_SCALAR(7)
+DEFINE_CHUNKYTOPLANAR_ROW_SCALAR(8)
+
+#undef STORE_PLANE_WORD
+#undef MERGE16
+
+#ifdef CHUNKYTOPLANAR_SSE2
+
+// Each bitplane is extracted from 16 pixels with one shift and one movemask. The pixel order
+//  within each group of 8 is reversed first, so that the leftmost pixel lands in bit 7.
+
+#define EXTRACT_PLANE(depth, plane) \
+	if (depth > plane) \
+	{ \
+		uint bits = (uint) _mm_movemask_epi8(_mm_slli_epi16(pixels, 7 - plane)); \
+		planeRows[plane][byteOffset] = (uint8_t) bits; \
+		planeRows[plane][byteOffset + 1] = (uint8_t) (bits >> 8); \
+	}
+
+#define DEFINE_CHUNKYTOPLANAR_ROW_SSE2(depth) \
+static void chunkyToPlanarRowSse2##depth(const uint8_t* chunky, uint numPixels, uint8_t* const* planeRows) \
+{ \
+	for (uint offset = 0; offset < numPixels; offset += 16) \
+	{ \
+		__m128i pixels = _mm_loadu_si128((const __m128i*) (chunky + offset)); \
+		pixels = _mm_shufflelo_epi16(pixels, _MM_SHUFFLE(0, 1, 2, 3)); \
+		pixels = _mm_shufflehi_epi16(pixels, _MM_SHUFFLE(0, 1, 2, 3)); \
+		pixels = _mm_or_si128(_mm_slli_epi16(pixels, 8), _mm_srli_epi16(pixels, 8)); \
+		uint byteOffset = offset >> 3; \
+		EXTRACT_PLANE(depth, 0); \
+		EXTRACT_PLANE(depth, 1); \
+		EXTRACT_PLANE(depth, 2); \
+		EXTRACT_PLANE(depth, 3); \
+		EXTRACT_PLANE(depth, 4); \
+		EXTRACT_PLANE(depth, 5); \
+		EXTRACT_PLANE(depth, 6); \
+		EXTRACT_PLANE(depth, 7); \
+	} \
+}
+
+DEFINE_CHUNKYTOPLANAR_ROW_SSE2(1)
+DEFINE_CHUNKYTOPLANAR_ROW_SSE2(2)
+DEFINE_CHUNKYTOPLANAR_ROW_SSE2(3)
+DEFINE_CHUNKYTOPLANAR_ROW_SSE2(4)
+DEFINE_CHUNKYTOPLANAR_ROW_SSE2(5)
+DEFINE_CHUNKYTOPLANAR_ROW_SSE2(6)
+DEFINE_CHUNKYTOPLANAR_ROW_SSE2(7)
+DEFINE_CHUNKYTOPLANAR_ROW_SSE2(8)
+
+#undef EXTRACT_PLANE
+
+#endif
+
+static const ChunkyToPlanarRowFunc chunkyToPlanarRowScalarFuncs[] = {
+	chunkyToPlanarRowScalar1, chunkyToPlanarRowScalar2, chunkyToPlanarRowScalar3, chunkyToPlanarRowScalar4,
+	chunkyToPlanarRowScalar5, chunkyToPlanarRowScalar6, chunkyToPlanarRowScalar7, chunkyToPlanarRowScalar8,
+};
+
+#ifdef CHUNKYTOPLANAR_SSE2
+static const ChunkyToPlanarRowFunc chunkyToPlanarRowSse2Funcs[] = {
+	chunkyToPlanarRowSse21, chunkyToPlanarRowSse22, chunkyToPlanarRowSse23, chunkyToPlanarRowSse24,
+	chunkyToPlanarRowSse25, chunkyToPlanarRowSse26, chunkyToPlanarRowSse27, chunkyToPlanarRowSse28,
+};
+#endif
+
+ChunkyToPlanarRowFunc selectChunkyToPlanarRowFunc(uint depth)
+{
+	if (depth < 1 || depth > 8)
+		return 0;
+
+#ifdef CHUNKYTOPLANAR_SSE2
+	return chunkyToPlanarRowSse2Funcs[depth - 1];
+#endif
+
+	return chunkyToPlanarRowScalarFuncs[depth - 1];
+}
@@ -0,0 +1,15 @@
+
+#ifndef CHUNKYTOPLANAR_H
+#define CHUNKYTOPLANAR_H
+
+#include "Types.h"
+
+// Converts a row of 8-bit chunky pixels into bitplane rows, 16 pixels at a time.
+//  The chunky row must be readable, and zero-padded, up to the next multiple of 16 pixels;
+//  ((numPixels + 15) / 16) * 2 bytes are written to each of planeRows[0 .. depth-1].
+typedef void (*ChunkyToPlanarRowFunc)(const uint8_t* chunky, uint numPixels, uint8_t* const* planeRows);
+
+// Picks the fastest converter available on this machine, specialized for the given depth (1-8)
+ChunkyToPlanarRowFunc selectChunkyToPlanarRowFunc(uint depth);
+
+#endif
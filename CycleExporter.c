@@ -0,0 +1,597 @@
+
+#include "Ilbm.h"
+#include "PaletteAnimation.h"
+#include "Thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Renders the color cycling of an image to a file, as fast as the machine allows. Each output
+//  frame only depends on its frame counter, so batches of frames are rendered and encoded by
+//  worker threads, each with a private PaletteAnimation, and then written out in order.
+//  Messages go to stderr, as the output may be going to stdout.
+
+typedef enum
+{
+	ExportFormat_Raw,
+	ExportFormat_Y4M,
+	ExportFormat_APNG,
+} ExportFormat;
+
+enum { DefaultTickRate = 50 };
+enum { MaxCycleFrames = 100000 };
+enum { FramesPerBatchPerThread = 4 };
+enum { MaxDeflateStoredBlockSize = 65535 };
+
+typedef struct
+{
+	const Ilbm* ilbm;
+	ExportFormat format;
+	uint frameStep;
+	uint64_t cycleFrames;	// After this many frames of the frame counter the palettes repeat; 0 if unknown
+	uint framesPerSecond;
+	bool blend;
+	uint maxFrameBytes;
+} Exporter;
+
+typedef struct
+{
+	const Exporter* exporter;
+	PaletteAnimation* animation;
+	uint firstFrame;
+	uint frameStride;
+	uint endFrame;
+	uint batchStartFrame;
+	uint8_t* rowBuffer;
+	uint8_t** frameBuffers;
+	uint* frameSizes;
+} ExportWorker;
+
+static uint32_t crcTable[256];
+
+static void initCrcTable(void)
+{
+	for (uint n = 0; n < 256; ++n)
+	{
+		uint32_t c = n;
+		for (uint k = 0; k < 8; ++k)
+			c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+		crcTable[n] = c;
+	}
+}
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t* data, uint size)
+{
+	for (uint i = 0; i < size; ++i)
+		crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+static void updateAdler32(uint32_t* a, uint32_t* b, const uint8_t* data, uint size)
+{
+	// 5552 bytes is the most that can be summed before the 32-bit sums could overflow
+	while (size)
+	{
+		uint blockSize = size < 5552 ? size : 5552;
+		for (uint i = 0; i < blockSize; ++i)
+		{
+			*a += data[i];
+			*b += *a;
+		}
+		*a %= 65521;
+		*b %= 65521;
+		data += blockSize;
+		size -= blockSize;
+	}
+}
+
+static uint8_t* writeUint32BE(uint8_t* dest, uint32_t value)
+{
+	dest[0] = (uint8_t) (value >> 24);
+	dest[1] = (uint8_t) (value >> 16);
+	dest[2] = (uint8_t) (value >> 8);
+	dest[3] = (uint8_t) value;
+	return dest + 4;
+}
+
+static uint8_t* writeUint16BE(uint8_t* dest, uint value)
+{
+	dest[0] = (uint8_t) (value >> 8);
+	dest[1] = (uint8_t) value;
+	return dest + 2;
+}
+
+// Fills in length and CRC around the dataSize bytes already written after an 8-byte chunk header
+static uint8_t* finishPngChunk(uint8_t* chunk, uint32_t id, uint dataSize)
+{
+	writeUint32BE(chunk, dataSize);
+	writeUint32BE(chunk + 4, id);
+	uint32_t crc = updateCrc(0xffffffff, chunk + 4, dataSize + 4) ^ 0xffffffff;
+	return writeUint32BE(chunk + 8 + dataSize, crc);
+}
+
+static uint getPngImageDataSize(const Ilbm* ilbm)
+{
+	return (1 + ilbm->width * 3) * ilbm->height;
+}
+
+static uint getZlibStoredSize(uint dataSize)
+{
+	uint numBlocks = (dataSize + MaxDeflateStoredBlockSize - 1) / MaxDeflateStoredBlockSize;
+	return 2 + numBlocks * 5 + dataSize + 4;
+}
+
+static uint getMaxFrameBytes(const Ilbm* ilbm, ExportFormat format)
+{
+	uint numPixels = ilbm->width * ilbm->height;
+
+	switch (format)
+	{
+		case ExportFormat_Raw:
+			return numPixels * 3;
+		case ExportFormat_Y4M:
+			return 6 + numPixels * 3;
+		case ExportFormat_APNG:
+			// fcTL, then IDAT or fdAT with its sequence number
+			return (12 + 26) + (12 + 4 + getZlibStoredSize(getPngImageDataSize(ilbm)));
+	}
+	return 0;
+}
+
+static uint encodeRaw(const Ilbm* ilbm, const uint32_t* palette, uint8_t* dest)
+{
+	uint8_t* destStart = dest;
+
+	for (uint y = 0; y < ilbm->height; ++y)
+	{
+		const uint8_t* pixels = ilbm->chunky + y * ilbm->chunkyPitch;
+		for (uint x = 0; x < ilbm->width; ++x)
+		{
+			uint32_t rgb = palette[pixels[x]];
+			*dest++ = (uint8_t) (rgb >> 16);
+			*dest++ = (uint8_t) (rgb >> 8);
+			*dest++ = (uint8_t) rgb;
+		}
+	}
+
+	return dest - destStart;
+}
+
+static uint encodeY4M(const Ilbm* ilbm, const uint32_t* palette, uint8_t* dest)
+{
+	uint8_t yuvPalette[3][256];
+	uint numPixels = ilbm->width * ilbm->height;
+
+	// BT.601, limited range
+	for (uint color = 0; color < 256; ++color)
+	{
+		int r = (palette[color] >> 16) & 0xff;
+		int g = (palette[color] >> 8) & 0xff;
+		int b = palette[color] & 0xff;
+		yuvPalette[0][color] = (uint8_t) (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		yuvPalette[1][color] = (uint8_t) ((-38 * r - 74 * g + 112 * b + 128 + 128 * 256) >> 8);
+		yuvPalette[2][color] = (uint8_t) ((112 * r - 94 * g - 18 * b + 128 + 128 * 256) >> 8);
+	}
+
+	memcpy(dest, "FRAME\n", 6);
+
+	for (uint plane = 0; plane < 3; ++plane)
+	{
+		uint8_t* planeDest = dest + 6 + plane * numPixels;
+		for (uint y = 0; y < ilbm->height; ++y)
+		{
+			const uint8_t* pixels = ilbm->chunky + y * ilbm->chunkyPitch;
+			for (uint x = 0; x < ilbm->width; ++x)
+				*planeDest++ = yuvPalette[plane][pixels[x]];
+		}
+	}
+
+	return 6 + numPixels * 3;
+}
+
+static uint encodeAPNG(const Exporter* exporter, uint frameIndex, const uint32_t* palette, uint8_t* rowBuffer, uint8_t* dest)
+{
+	const Ilbm* ilbm = exporter->ilbm;
+	uint8_t* destStart = dest;
+
+	// fcTL and fdAT chunks share one sequence: fcTL 0, IDAT, then fcTL 1, fdAT 2, fcTL 3, ...
+	uint sequenceNumber = frameIndex ? frameIndex * 2 - 1 : 0;
+
+	uint8_t* chunk = dest;
+	dest = writeUint32BE(chunk + 8, sequenceNumber);
+	dest = writeUint32BE(dest, ilbm->width);
+	dest = writeUint32BE(dest, ilbm->height);
+	dest = writeUint32BE(dest, 0);
+	dest = writeUint32BE(dest, 0);
+	dest = writeUint16BE(dest, 1);
+	dest = writeUint16BE(dest, exporter->framesPerSecond);
+	*dest++ = 0;	// dispose op: none
+	*dest++ = 0;	// blend op: source
+	dest = finishPngChunk(chunk, 'fcTL', 26);
+
+	chunk = dest;
+	dest += 8;
+	if (frameIndex)
+		dest = writeUint32BE(dest, sequenceNumber + 1);
+
+	// zlib stream made of stored deflate blocks, so no compressor is needed
+	uint8_t* zlibStart = dest;
+	*dest++ = 0x78;
+	*dest++ = 0x01;
+
+	uint imageDataSize = getPngImageDataSize(ilbm);
+	uint blockBytesLeft = 0;
+	uint imageBytesLeft = imageDataSize;
+	uint32_t adlerA = 1;
+	uint32_t adlerB = 0;
+
+	for (uint y = 0; y < ilbm->height; ++y)
+	{
+		const uint8_t* pixels = ilbm->chunky + y * ilbm->chunkyPitch;
+		uint rowSize = 1 + ilbm->width * 3;
+		uint8_t* row = rowBuffer;
+
+		*row++ = 0;	// filter: none
+		for (uint x = 0; x < ilbm->width; ++x)
+		{
+			uint32_t rgb = palette[pixels[x]];
+			*row++ = (uint8_t) (rgb >> 16);
+			*row++ = (uint8_t) (rgb >> 8);
+			*row++ = (uint8_t) rgb;
+		}
+
+		updateAdler32(&adlerA, &adlerB, rowBuffer, rowSize);
+
+		for (uint rowOffset = 0; rowOffset < rowSize; )
+		{
+			if (!blockBytesLeft)
+			{
+				blockBytesLeft = imageBytesLeft < MaxDeflateStoredBlockSize ? imageBytesLeft : MaxDeflateStoredBlockSize;
+				*dest++ = (imageBytesLeft == blockBytesLeft) ? 1 : 0;
+				*dest++ = (uint8_t) blockBytesLeft;
+				*dest++ = (uint8_t) (blockBytesLeft >> 8);
+				*dest++ = (uint8_t) ~blockBytesLeft;
+				*dest++ = (uint8_t) (~blockBytesLeft >> 8);
+			}
+
+			uint bytesToCopy = rowSize - rowOffset < blockBytesLeft ? rowSize - rowOffset : blockBytesLeft;
+			memcpy(dest, rowBuffer + rowOffset, bytesToCopy);
+			dest += bytesToCopy;
+			rowOffset += bytesToCopy;
+			blockBytesLeft -= bytesToCopy;
+			imageBytesLeft -= bytesToCopy;
+		}
+	}
+
+	dest = writeUint32BE(dest, (adlerB << 16) | adlerA);
+
+	uint chunkDataSize = (dest - zlibStart) + (frameIndex ? 4 : 0);
+	dest = finishPngChunk(chunk, frameIndex ? 'fdAT' : 'IDAT', chunkDataSize);
+
+	return dest - destStart;
+}
+
+// The palettes are a function of a 32-bit 16.16 frame counter. Output frames are placed on it in
+//  64 bits and brought back into the first cycle, so that exports longer than 65536 ticks loop
+//  instead of wrapping the counter partway through a cycle.
+static uint getExportFrame(const Exporter* exporter, uint frameIndex)
+{
+	uint64_t frame = (uint64_t) frameIndex * exporter->frameStep;
+	if (exporter->cycleFrames)
+		frame %= exporter->cycleFrames;
+	return (uint) frame;
+}
+
+// Checks that the palette comes back to where it started after one cycle
+static bool verifyCycle(const Exporter* exporter)
+{
+	const Ilbm* ilbm = exporter->ilbm;
+	PaletteAnimation* animation = createPaletteAnimation(ilbm);
+	if (!animation)
+		return false;
+
+	uint32_t firstPalette[256];
+	memcpy(firstPalette, animatePalette(animation, 0, exporter->blend), ilbm->palette.numColors * sizeof(uint32_t));
+	const uint32_t* nextCyclePalette = animatePalette(animation, (uint) exporter->cycleFrames, exporter->blend);
+	bool repeats = !memcmp(firstPalette, nextCyclePalette, ilbm->palette.numColors * sizeof(uint32_t));
+
+	freePaletteAnimation(animation);
+	return repeats;
+}
+
+static void exportFrames(void* argument)
+{
+	ExportWorker* worker = (ExportWorker*) argument;
+	const Exporter* exporter = worker->exporter;
+	const Ilbm* ilbm = exporter->ilbm;
+	uint32_t palette[256] = { 0 };
+
+	for (uint frameIndex = worker->firstFrame; frameIndex < worker->endFrame; frameIndex += worker->frameStride)
+	{
+		const uint32_t* colors = animatePalette(worker->animation, getExportFrame(exporter, frameIndex), exporter->blend);
+		memcpy(palette, colors, ilbm->palette.numColors * sizeof(uint32_t));
+
+		uint slot = frameIndex - worker->batchStartFrame;
+		uint8_t* dest = worker->frameBuffers[slot];
+
+		if (exporter->format == ExportFormat_Raw)
+			worker->frameSizes[slot] = encodeRaw(ilbm, palette, dest);
+		else if (exporter->format == ExportFormat_Y4M)
+			worker->frameSizes[slot] = encodeY4M(ilbm, palette, dest);
+		else
+			worker->frameSizes[slot] = encodeAPNG(exporter, frameIndex, palette, worker->rowBuffer, dest);
+	}
+}
+
+static bool writeHeader(const Exporter* exporter, uint numFrames, FILE* file)
+{
+	const Ilbm* ilbm = exporter->ilbm;
+
+	if (exporter->format == ExportFormat_Y4M)
+		return fprintf(file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n", ilbm->width, ilbm->height, exporter->framesPerSecond) > 0;
+
+	if (exporter->format == ExportFormat_APNG)
+	{
+		uint8_t header[8 + (12 + 13) + (12 + 8)];
+		memcpy(header, "\x89PNG\r\n\x1a\n", 8);
+
+		uint8_t* chunk = header + 8;
+		uint8_t* dest = writeUint32BE(chunk + 8, ilbm->width);
+		dest = writeUint32BE(dest, ilbm->height);
+		*dest++ = 8;	// bits per channel
+		*dest++ = 2;	// truecolor
+		*dest++ = 0;
+		*dest++ = 0;
+		*dest++ = 0;
+		chunk = finishPngChunk(chunk, 'IHDR', 13);
+
+		dest = writeUint32BE(chunk + 8, numFrames);
+		dest = writeUint32BE(dest, 0);	// loop forever
+		finishPngChunk(chunk, 'acTL', 8);
+
+		return fwrite(header, sizeof header, 1, file) == 1;
+	}
+
+	return true;
+}
+
+static bool writeFooter(const Exporter* exporter, FILE* file)
+{
+	if (exporter->format == ExportFormat_APNG)
+	{
+		uint8_t footer[12];
+		finishPngChunk(footer, 'IEND', 0);
+		return fwrite(footer, sizeof footer, 1, file) == 1;
+	}
+
+	return true;
+}
+
+static bool exportAnimation(const Exporter* exporter, uint numFrames, uint numThreads, FILE* file)
+{
+	uint batchSize = numThreads * FramesPerBatchPerThread;
+	ExportWorker workers[64];
+	uint8_t** frameBuffers = 0;
+	uint* frameSizes = 0;
+	bool success = false;
+
+	memset(workers, 0, sizeof workers);
+
+	if (!(frameBuffers = calloc(batchSize, sizeof(uint8_t*)))
+		|| !(frameSizes = calloc(batchSize, sizeof(uint))))
+		goto exit;
+
+	for (uint slot = 0; slot < batchSize; ++slot)
+		if (!(frameBuffers[slot] = malloc(exporter->maxFrameBytes)))
+			goto exit;
+
+	for (uint threadId = 0; threadId < numThreads; ++threadId)
+		if (!(workers[threadId].animation = createPaletteAnimation(exporter->ilbm))
+			|| !(workers[threadId].rowBuffer = malloc(1 + exporter->ilbm->width * 3)))
+			goto exit;
+
+	if (!writeHeader(exporter, numFrames, file))
+		goto exit;
+
+	for (uint batchStartFrame = 0; batchStartFrame < numFrames; batchStartFrame += batchSize)
+	{
+		uint batchEndFrame = batchStartFrame + batchSize < numFrames ? batchStartFrame + batchSize : numFrames;
+		Thread* threads[64];
+
+		for (uint threadId = 0; threadId < numThreads; ++threadId)
+		{
+			ExportWorker* worker = &workers[threadId];
+			worker->exporter = exporter;
+			worker->firstFrame = batchStartFrame + threadId;
+			worker->frameStride = numThreads;
+			worker->endFrame = batchEndFrame;
+			worker->batchStartFrame = batchStartFrame;
+			worker->frameBuffers = frameBuffers;
+			worker->frameSizes = frameSizes;
+		}
+
+		// The calling thread renders its share while the others run
+		for (uint threadId = 1; threadId < numThreads; ++threadId)
+			threads[threadId] = startThread(exportFrames, &workers[threadId]);
+		exportFrames(&workers[0]);
+		for (uint threadId = 1; threadId < numThreads; ++threadId)
+			if (threads[threadId])
+				joinThread(threads[threadId]);
+
+		for (uint frameIndex = batchStartFrame; frameIndex < batchEndFrame; ++frameIndex)
+		{
+			uint slot = frameIndex - batchStartFrame;
+			if (fwrite(frameBuffers[slot], 1, frameSizes[slot], file) != frameSizes[slot])
+				goto exit;
+		}
+	}
+
+	success = writeFooter(exporter, file);
+
+exit:
+	for (uint threadId = 0; threadId < numThreads; ++threadId)
+	{
+		if (workers[threadId].animation)
+			freePaletteAnimation(workers[threadId].animation);
+		free(workers[threadId].rowBuffer);
+	}
+
+	if (frameBuffers)
+		for (uint slot = 0; slot < batchSize; ++slot)
+			free(frameBuffers[slot]);
+	free(frameBuffers);
+	free(frameSizes);
+
+	if (!success)
+		fprintf(stderr, "Unable to export animation\n");
+	return success;
+}
+
+void parseErrorCallback(void* context, const IffErrorLocation* location, const char* message)
+{
+	char where[512];
+	formatIffErrorLocation(where, sizeof where, location);
+	fprintf(stderr, "Error: %s (%s)\n", message, where);
+}
+
+static void printUsage(void)
+{
+	printf("Usage: CycleExporter [options] <filename> <output file, or - for stdout>\n\n");
+	printf("Renders the color cycling of an IFF image to a raw RGB, Y4M or APNG file.\n");
+	printf("Options:\n");
+	printf("  -format raw|y4m|apng   output format (default raw: 24-bit RGB frames back to back)\n");
+	printf("  -frames <n>            number of frames (default: exactly one full cycle)\n");
+	printf("  -fps <n>               output frame rate (default: the tick rate)\n");
+	printf("  -tickrate <n>          color cycling ticks per second (default %u, like DPaint)\n", (uint) DefaultTickRate);
+	printf("  -speed <1-9>           color cycling delay, like the viewer's 1-9 keys (default 1)\n");
+	printf("  -blend                 blend between colors instead of stepping\n");
+	printf("  -threads <n>           worker threads (default: one per hardware thread)\n");
+}
+
+int main(int argc, char** argv)
+{
+	ExportFormat format = ExportFormat_Raw;
+	uint numFrames = 0;
+	uint framesPerSecond = 0;
+	uint tickRate = DefaultTickRate;
+	uint speed = 1;
+	bool blend = false;
+	uint numThreads = getNumHardwareThreads();
+
+	while (argc > 3 && argv[1][0] == '-' && argv[1][1])
+	{
+		bool hasValue = argc > 4;
+		const char* value = argv[2];
+
+		if (!strcmp(argv[1], "-blend"))
+		{
+			blend = true;
+			argv++;
+			argc--;
+			continue;
+		}
+
+		if (!hasValue)
+			break;
+		else if (!strcmp(argv[1], "-format") && !strcmp(value, "raw"))
+			format = ExportFormat_Raw;
+		else if (!strcmp(argv[1], "-format") && !strcmp(value, "y4m"))
+			format = ExportFormat_Y4M;
+		else if (!strcmp(argv[1], "-format") && !strcmp(value, "apng"))
+			format = ExportFormat_APNG;
+		else if (!strcmp(argv[1], "-frames"))
+			numFrames = (uint) atoi(value);
+		else if (!strcmp(argv[1], "-fps"))
+			framesPerSecond = (uint) atoi(value);
+		else if (!strcmp(argv[1], "-tickrate"))
+			tickRate = (uint) atoi(value);
+		else if (!strcmp(argv[1], "-speed"))
+			speed = (uint) atoi(value);
+		else if (!strcmp(argv[1], "-threads"))
+			numThreads = (uint) atoi(value);
+		else
+			break;
+
+		argv += 2;
+		argc -= 2;
+	}
+
+	if (!framesPerSecond)
+		framesPerSecond = tickRate;
+
+	if (argc != 3 || !tickRate || speed < 1 || speed > 9 || framesPerSecond > 65535)
+	{
+		printUsage();
+		return 0;
+	}
+
+	if (numThreads < 1)
+		numThreads = 1;
+	if (numThreads > 64)
+		numThreads = 64;
+
+	LoadIffImageOptions options = { 0 };
+	options.chunkyOutput = true;
+	options.parallelDecode = true;
+
+	Ilbm* ilbm = loadIffImageWithOptions(argv[1], &options, parseErrorCallback, 0);
+	if (!ilbm)
+		return -1;
+
+	Exporter exporter;
+	exporter.ilbm = ilbm;
+	exporter.format = format;
+	exporter.frameStep = (uint) ((65536ull * tickRate) / ((uint64_t) framesPerSecond * speed));
+	exporter.framesPerSecond = framesPerSecond;
+	exporter.blend = blend;
+	exporter.maxFrameBytes = getMaxFrameBytes(ilbm, format);
+
+	// Only cycles which fit on the frame counter can be looped
+	uint maxCounterFrames = exporter.frameStep ? 0xffffffffu / exporter.frameStep : 0;
+	uint period = getPaletteAnimationPeriod(ilbm, exporter.frameStep, maxCounterFrames);
+	exporter.cycleFrames = (uint64_t) period * exporter.frameStep;
+
+	if (!numFrames)
+	{
+		if (!period || period > MaxCycleFrames)
+		{
+			uint maxFrames = maxCounterFrames < MaxCycleFrames ? maxCounterFrames : MaxCycleFrames;
+			fprintf(stderr, "The color cycle of %s is longer than %u frames; use -frames to pick a length\n", argv[1], maxFrames);
+			freeIlbm(ilbm);
+			return -1;
+		}
+		numFrames = period;
+	}
+	else if (!period && (uint64_t) (numFrames - 1) * exporter.frameStep > 0xffffffffu)
+	{
+		fprintf(stderr, "At most %u frames of %s can be exported at this speed\n", maxCounterFrames + 1, argv[1]);
+		freeIlbm(ilbm);
+		return -1;
+	}
+
+	if (period && !verifyCycle(&exporter))
+	{
+		fprintf(stderr, "The color cycle of %s does not repeat after %u frames\n", argv[1], period);
+		freeIlbm(ilbm);
+		return -1;
+	}
+
+	FILE* file = strcmp(argv[2], "-") ? fopen(argv[2], "wb") : stdout;
+	if (!file)
+	{
+		fprintf(stderr, "Unable to open %s for writing\n", argv[2]);
+		freeIlbm(ilbm);
+		return -1;
+	}
+
+	initCrcTable();
+
+	bool success = exportAnimation(&exporter, numFrames, numThreads, file);
+
+	if (file != stdout)
+		fclose(file);
+	freeIlbm(ilbm);
+
+	return success ? 0 : -1;
+}
@@ -0,0 +1,135 @@
+
+#include "FileList.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef AMIGA
+#include <proto/dos.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+static bool addFile(FileList* fileList, const char* directory, const char* fileName)
+{
+	if (fileList->numFiles == fileList->capacity)
+	{
+		uint capacity = fileList->capacity ? fileList->capacity * 2 : 16;
+		char** fileNames = realloc(fileList->fileNames, capacity * sizeof(char*));
+		if (!fileNames)
+			return false;
+		fileList->fileNames = fileNames;
+		fileList->capacity = capacity;
+	}
+
+	size_t directoryLength = directory ? strlen(directory) : 0;
+	char* path = malloc(directoryLength + 1 + strlen(fileName) + 1);
+	if (!path)
+		return false;
+
+	path[0] = 0;
+	if (directory)
+	{
+		strcpy(path, directory);
+#ifdef AMIGA
+		bool needSeparator = directoryLength && directory[directoryLength - 1] != '/' && directory[directoryLength - 1] != ':';
+#else
+		bool needSeparator = directoryLength && directory[directoryLength - 1] != '/';
+#endif
+		if (needSeparator)
+			strcat(path, "/");
+	}
+	strcat(path, fileName);
+
+	fileList->fileNames[fileList->numFiles++] = path;
+	return true;
+}
+
+static int compareFileNames(const void* a, const void* b)
+{
+	return strcmp(*(const char* const*) a, *(const char* const*) b);
+}
+
+#ifdef AMIGA
+
+bool addFileOrDirectory(FileList* fileList, const char* path)
+{
+	BPTR lock = Lock((STRPTR) path, ACCESS_READ);
+	if (!lock)
+		return false;
+
+	struct FileInfoBlock* fileInfo = AllocDosObject(DOS_FIB, 0);
+	if (!fileInfo || !Examine(lock, fileInfo))
+	{
+		if (fileInfo)
+			FreeDosObject(DOS_FIB, fileInfo);
+		UnLock(lock);
+		return false;
+	}
+
+	bool success = true;
+	uint firstFile = fileList->numFiles;
+
+	if (fileInfo->fib_DirEntryType < 0)
+		success = addFile(fileList, 0, path);
+	else
+		while (success && ExNext(lock, fileInfo))
+			if (fileInfo->fib_DirEntryType < 0)
+				success = addFile(fileList, path, fileInfo->fib_FileName);
+
+	FreeDosObject(DOS_FIB, fileInfo);
+	UnLock(lock);
+
+	qsort(fileList->fileNames + firstFile, fileList->numFiles - firstFile, sizeof(char*), compareFileNames);
+	return success;
+}
+
+#else
+
+bool addFileOrDirectory(FileList* fileList, const char* path)
+{
+	struct stat pathStat;
+	if (stat(path, &pathStat))
+		return false;
+
+	if (!S_ISDIR(pathStat.st_mode))
+		return addFile(fileList, 0, path);
+
+	DIR* directory = opendir(path);
+	if (!directory)
+		return false;
+
+	bool success = true;
+	uint firstFile = fileList->numFiles;
+	struct dirent* entry;
+
+	while (success && (entry = readdir(directory)))
+	{
+		if (entry->d_name[0] == '.')
+			continue;
+
+		if (!addFile(fileList, path, entry->d_name))
+			success = false;
+		else if (stat(fileList->fileNames[fileList->numFiles - 1], &pathStat) || !S_ISREG(pathStat.st_mode))
+			free(fileList->fileNames[--fileList->numFiles]);
+	}
+
+	closedir(directory);
+
+	qsort(fileList->fileNames + firstFile, fileList->numFiles - firstFile, sizeof(char*), compareFileNames);
+	return success;
+}
+
+#endif
+
+void freeFileList(FileList* fileList)
+{
+	for (uint i = 0; i < fileList->numFiles; ++i)
+		free(fileList->fileNames[i]);
+	free(fileList->fileNames);
+
+	fileList->fileNames = 0;
+	fileList->numFiles = 0;
+	fileList->capacity = 0;
+}
@@ -0,0 +1,21 @@
+#ifndef FILELIST_H
+#define FILELIST_H
+
+#include "Types.h"
+
+// A growing list of file names, for walking through several images
+
+typedef struct
+{
+	char** fileNames;
+	uint numFiles;
+	uint capacity;
+} FileList;
+
+// Adds a file, or all files directly inside a directory in name order. Returns false if the
+//  path cannot be examined, or on out-of-memory.
+bool addFileOrDirectory(FileList* fileList, const char* path);
+
+void freeFileList(FileList* fileList);
+
+#endif
@@ -0,0 +1,170 @@
+
+#include "FileWatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef AMIGA
+#include <dos/notify.h>
+#include <proto/dos.h>
+#include <proto/exec.h>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef AMIGA
+
+struct FileWatch
+{
+	struct NotifyRequest request;
+	BYTE signalBit;
+	char* fileName;
+};
+
+FileWatch* startFileWatch(const char* fileName)
+{
+	FileWatch* watch = malloc(sizeof(FileWatch));
+	if (!watch)
+		return 0;
+
+	memset(watch, 0, sizeof(FileWatch));
+
+	if (!(watch->fileName = malloc(strlen(fileName) + 1)))
+	{
+		free(watch);
+		return 0;
+	}
+	strcpy(watch->fileName, fileName);
+
+	if ((watch->signalBit = AllocSignal(-1)) == -1)
+	{
+		free(watch->fileName);
+		free(watch);
+		return 0;
+	}
+
+	// The file system sends the signal once a file which was opened for writing is closed
+	watch->request.nr_Name = (STRPTR) watch->fileName;
+	watch->request.nr_Flags = NRF_SEND_SIGNAL;
+	watch->request.nr_stuff.nr_Signal.nr_Task = FindTask(0);
+	watch->request.nr_stuff.nr_Signal.nr_SignalNum = watch->signalBit;
+
+	if (!StartNotify(&watch->request))
+	{
+		FreeSignal(watch->signalBit);
+		free(watch->fileName);
+		free(watch);
+		return 0;
+	}
+
+	return watch;
+}
+
+void stopFileWatch(FileWatch* watch)
+{
+	if (!watch)
+		return;
+
+	EndNotify(&watch->request);
+	FreeSignal(watch->signalBit);
+	free(watch->fileName);
+	free(watch);
+}
+
+bool checkFileWatch(FileWatch* watch)
+{
+	ULONG signalMask = 1UL << watch->signalBit;
+	return (SetSignal(0, signalMask) & signalMask) != 0;
+}
+
+#else
+
+struct FileWatch
+{
+	int inotifyDescriptor;
+	char* baseName;
+};
+
+FileWatch* startFileWatch(const char* fileName)
+{
+	FileWatch* watch = malloc(sizeof(FileWatch));
+	if (!watch)
+		return 0;
+
+	// Watch the directory rather than the file; editors which save by renaming a new file
+	//  over the old one would otherwise leave the watch on the replaced file
+	const char* separator = strrchr(fileName, '/');
+	size_t directoryLength = separator ? (size_t) (separator - fileName) : 0;
+	char* directory = malloc(directoryLength + 2);
+	const char* baseName = separator ? separator + 1 : fileName;
+
+	watch->baseName = malloc(strlen(baseName) + 1);
+	if (!directory || !watch->baseName)
+	{
+		free(directory);
+		free(watch->baseName);
+		free(watch);
+		return 0;
+	}
+	strcpy(watch->baseName, baseName);
+
+	if (!separator)
+		strcpy(directory, ".");
+	else if (!directoryLength)
+		strcpy(directory, "/");
+	else
+	{
+		memcpy(directory, fileName, directoryLength);
+		directory[directoryLength] = 0;
+	}
+
+	watch->inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	bool watching = (watch->inotifyDescriptor >= 0)
+		&& (inotify_add_watch(watch->inotifyDescriptor, directory, IN_CLOSE_WRITE | IN_MOVED_TO) >= 0);
+	free(directory);
+
+	if (!watching)
+	{
+		if (watch->inotifyDescriptor >= 0)
+			close(watch->inotifyDescriptor);
+		free(watch->baseName);
+		free(watch);
+		return 0;
+	}
+
+	return watch;
+}
+
+void stopFileWatch(FileWatch* watch)
+{
+	if (!watch)
+		return;
+
+	close(watch->inotifyDescriptor);
+	free(watch->baseName);
+	free(watch);
+}
+
+bool checkFileWatch(FileWatch* watch)
+{
+	bool written = false;
+	char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	ssize_t bytesRead;
+
+	// Drain all pending events; other files in the same directory are of no interest
+	while ((bytesRead = read(watch->inotifyDescriptor, buffer, sizeof buffer)) > 0)
+	{
+		for (char* eventPtr = buffer; eventPtr < buffer + bytesRead; )
+		{
+			const struct inotify_event* event = (const struct inotify_event*) eventPtr;
+			if (event->len && !strcmp(event->name, watch->baseName))
+				written = true;
+			eventPtr += sizeof(struct inotify_event) + event->len;
+		}
+	}
+
+	return written;
+}
+
+#endif
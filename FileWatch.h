@@ -0,0 +1,19 @@
+#ifndef FILEWATCH_H
+#define FILEWATCH_H
+
+#include "Types.h"
+
+// Tells when a file has been written to, without polling the file system: inotify on the
+//  directory of the file on Linux, a DOS notification request on AmigaOS. Saving through a
+//  temporary file which is then renamed over the watched one is noticed as well.
+
+typedef struct FileWatch FileWatch;
+
+// Returns 0 if the file cannot be watched
+FileWatch* startFileWatch(const char* fileName);
+void stopFileWatch(FileWatch* watch);
+
+// True if the file has been written since the previous call; never blocks
+bool checkFileWatch(FileWatch* watch);
+
+#endif
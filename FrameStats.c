@@ -0,0 +1,232 @@
+
+#include "FrameStats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Bucket 0 holds times below 1 us, bucket n times from 2^(n-1) up to 2^n us, and the last bucket
+//  everything longer
+enum { NumFrameTimeBuckets = 20 };
+
+typedef enum
+{
+	FrameMeasure_Work = NumFramePhases,	// From the vertical blank to the last phase of the frame
+	FrameMeasure_Interval,	// From one vertical blank to the next
+	NumFrameMeasures,
+} FrameMeasure;
+
+static const char* s_measureNames[NumFrameMeasures] = { "input", "image_changes", "palette_compute", "palette_upload", "work", "interval" };
+
+typedef struct
+{
+	uint numFrames;
+	TimerTicks minTicks;
+	TimerTicks maxTicks;
+	TimerTicks totalTicks;
+	uint buckets[NumFrameTimeBuckets];
+} FrameTimeHistogram;
+
+struct FrameStats
+{
+	TimerTicks ticksPerFrame;
+	uint verticalBlanksPerSecond;
+	uint numFrames;
+	uint numMissedVerticalBlanks;
+	uint numFramesOverBudget;
+
+	bool inFrame;
+	TimerTicks frameStart;
+	TimerTicks lastMark;
+	TimerTicks phaseTicks[NumFramePhases];
+
+	FrameTimeHistogram histograms[NumFrameMeasures];
+};
+
+FrameStats* createFrameStats(uint verticalBlanksPerSecond)
+{
+	if (!initTimer())
+		return 0;
+
+	FrameStats* stats = (FrameStats*) malloc(sizeof(FrameStats));
+	if (!stats)
+	{
+		shutdownTimer();
+		return 0;
+	}
+
+	memset(stats, 0, sizeof *stats);
+	stats->verticalBlanksPerSecond = verticalBlanksPerSecond;
+	stats->ticksPerFrame = getTimerTicksPerSecond() / verticalBlanksPerSecond;
+	return stats;
+}
+
+void freeFrameStats(FrameStats* stats)
+{
+	if (!stats)
+		return;
+
+	free(stats);
+	shutdownTimer();
+}
+
+static void addFrameTime(FrameTimeHistogram* histogram, TimerTicks ticks)
+{
+	uint microseconds = (uint) timerTicksToMicroseconds(ticks);
+	uint bucket = 0;
+	while (microseconds && bucket < NumFrameTimeBuckets - 1)
+	{
+		microseconds >>= 1;
+		bucket++;
+	}
+
+	histogram->buckets[bucket]++;
+	histogram->totalTicks += ticks;
+	if (!histogram->numFrames || ticks < histogram->minTicks)
+		histogram->minTicks = ticks;
+	if (ticks > histogram->maxTicks)
+		histogram->maxTicks = ticks;
+	histogram->numFrames++;
+}
+
+void beginFrameStats(FrameStats* stats)
+{
+	if (!stats)
+		return;
+
+	TimerTicks now = readTimer();
+
+	if (stats->inFrame)
+	{
+		for (uint phase = 0; phase < NumFramePhases; ++phase)
+			addFrameTime(&stats->histograms[phase], stats->phaseTicks[phase]);
+
+		TimerTicks work = stats->lastMark - stats->frameStart;
+		TimerTicks interval = now - stats->frameStart;
+		addFrameTime(&stats->histograms[FrameMeasure_Work], work);
+		addFrameTime(&stats->histograms[FrameMeasure_Interval], interval);
+
+		// A frame which took closer to two vertical blanks than to one missed one of them
+		if (interval > stats->ticksPerFrame + stats->ticksPerFrame / 2)
+			stats->numMissedVerticalBlanks += (uint) ((interval + stats->ticksPerFrame / 2) / stats->ticksPerFrame) - 1;
+		if (work > stats->ticksPerFrame)
+			stats->numFramesOverBudget++;
+
+		stats->numFrames++;
+	}
+
+	memset(stats->phaseTicks, 0, sizeof stats->phaseTicks);
+	stats->frameStart = now;
+	stats->lastMark = now;
+	stats->inFrame = true;
+}
+
+void markFramePhase(FrameStats* stats, FramePhase phase)
+{
+	if (!stats || !stats->inFrame)
+		return;
+
+	TimerTicks now = readTimer();
+	stats->phaseTicks[phase] += now - stats->lastMark;
+	stats->lastMark = now;
+}
+
+static void formatBucket(char* buffer, uint bucket)
+{
+	if (!bucket)
+		sprintf(buffer, "< 1 us");
+	else if (bucket == NumFrameTimeBuckets - 1)
+		sprintf(buffer, ">= %u us", 1u << (bucket - 1));
+	else
+		sprintf(buffer, "%u-%u us", 1u << (bucket - 1), 1u << bucket);
+}
+
+static double getMeanMicroseconds(const FrameTimeHistogram* histogram)
+{
+	return histogram->numFrames ? timerTicksToMicroseconds(histogram->totalTicks) / histogram->numFrames : 0.0;
+}
+
+void printFrameStats(const FrameStats* stats)
+{
+	if (!stats)
+		return;
+
+	printf("Frame statistics over %u frames, %.0f us per frame at %u vertical blanks per second:\n",
+		stats->numFrames, timerTicksToMicroseconds(stats->ticksPerFrame), stats->verticalBlanksPerSecond);
+	printf("  %u vertical blanks missed, %u frames over budget\n", stats->numMissedVerticalBlanks, stats->numFramesOverBudget);
+
+	printf("  %-16s", "");
+	for (uint measure = 0; measure < NumFrameMeasures; ++measure)
+		printf(" %15s", s_measureNames[measure]);
+	printf("\n");
+
+	static const char* rowNames[3] = { "min us", "mean us", "max us" };
+	for (uint row = 0; row < 3; ++row)
+	{
+		printf("  %-16s", rowNames[row]);
+		for (uint measure = 0; measure < NumFrameMeasures; ++measure)
+		{
+			const FrameTimeHistogram* histogram = &stats->histograms[measure];
+			double microseconds = (row == 0) ? timerTicksToMicroseconds(histogram->minTicks)
+				: (row == 1) ? getMeanMicroseconds(histogram)
+				: timerTicksToMicroseconds(histogram->maxTicks);
+			printf(" %15.1f", microseconds);
+		}
+		printf("\n");
+	}
+
+	// Frames per bucket; buckets which no measure falls into are left out
+	for (uint bucket = 0; bucket < NumFrameTimeBuckets; ++bucket)
+	{
+		bool used = false;
+		for (uint measure = 0; measure < NumFrameMeasures; ++measure)
+			if (stats->histograms[measure].buckets[bucket])
+				used = true;
+		if (!used)
+			continue;
+
+		char bucketName[32];
+		formatBucket(bucketName, bucket);
+		printf("  %-16s", bucketName);
+		for (uint measure = 0; measure < NumFrameMeasures; ++measure)
+			printf(" %15u", stats->histograms[measure].buckets[bucket]);
+		printf("\n");
+	}
+}
+
+bool writeFrameStatsFile(const FrameStats* stats, const char* fileName)
+{
+	if (!stats)
+		return false;
+
+	FILE* fileHandle = fopen(fileName, "w");
+	if (!fileHandle)
+		return false;
+
+	fprintf(fileHandle, "frames %u\n", stats->numFrames);
+	fprintf(fileHandle, "vertical_blanks_per_second %u\n", stats->verticalBlanksPerSecond);
+	fprintf(fileHandle, "frame_budget_us %.1f\n", timerTicksToMicroseconds(stats->ticksPerFrame));
+	fprintf(fileHandle, "missed_vertical_blanks %u\n", stats->numMissedVerticalBlanks);
+	fprintf(fileHandle, "frames_over_budget %u\n", stats->numFramesOverBudget);
+
+	// Bucket n counts times below bucket_upper_us[n]; the last bucket has no upper bound
+	fprintf(fileHandle, "bucket_upper_us");
+	for (uint bucket = 0; bucket < NumFrameTimeBuckets - 1; ++bucket)
+		fprintf(fileHandle, " %u", 1u << bucket);
+	fprintf(fileHandle, " inf\n");
+
+	// Then per measure, "<measure>_us <min> <mean> <max>" and "<measure>_buckets <frames per bucket...>"
+	for (uint measure = 0; measure < NumFrameMeasures; ++measure)
+	{
+		const FrameTimeHistogram* histogram = &stats->histograms[measure];
+		fprintf(fileHandle, "%s_us %.1f %.1f %.1f\n", s_measureNames[measure], timerTicksToMicroseconds(histogram->minTicks),
+			getMeanMicroseconds(histogram), timerTicksToMicroseconds(histogram->maxTicks));
+
+		fprintf(fileHandle, "%s_buckets", s_measureNames[measure]);
+		for (uint bucket = 0; bucket < NumFrameTimeBuckets; ++bucket)
+			fprintf(fileHandle, " %u", histogram->buckets[bucket]);
+		fprintf(fileHandle, "\n");
+	}
+
+	return fclose(fileHandle) == 0;
+}
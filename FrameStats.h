@@ -0,0 +1,38 @@
+
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include "Types.h"
+#include "Timer.h"
+
+// Records how long each part of every displayed frame takes, and how many vertical blanks are
+//  missed, as histograms with power-of-two microsecond buckets. All functions do nothing when
+//  given a null FrameStats, so the display loop can call them unconditionally.
+
+typedef enum
+{
+	FramePhase_Input,
+	FramePhase_ImageChanges,	// Reloads, file watching, slideshow steps and palette baking
+	FramePhase_PaletteCompute,
+	FramePhase_PaletteUpload,
+	NumFramePhases,
+} FramePhase;
+
+typedef struct FrameStats FrameStats;
+
+// Opens the timer; returns 0 if there is no timer or no memory
+FrameStats* createFrameStats(uint verticalBlanksPerSecond);
+void freeFrameStats(FrameStats* stats);
+
+// Call right after each vertical blank; ends the previous frame
+void beginFrameStats(FrameStats* stats);
+
+// The time since the previous mark, or since the frame began, is counted towards phase
+void markFramePhase(FrameStats* stats, FramePhase phase);
+
+void printFrameStats(const FrameStats* stats);
+
+// Writes the statistics as "key value..." lines, for scripts to pick up
+bool writeFrameStatsFile(const FrameStats* stats, const char* fileName);
+
+#endif
@@ -0,0 +1,97 @@
+
+#include "SyntheticImage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void printUsage(void)
+{
+	printf("usage: GenerateTestImage [-size <width>x<height>] [-depth <planes>] [-pbm] [-raw] [-run <pixels>] [-ranges <count>] [-seed <number>] <output file>\n");
+	printf("  Defaults: -size 320x256 -depth 5 -run 8 -ranges 4 -seed 1, ILBM, compressed\n");
+}
+
+int main(int argc, char** argv)
+{
+	SyntheticImageParams params;
+	setDefaultSyntheticImageParams(&params);
+
+	while (argc > 2 && argv[1][0] == '-')
+	{
+		if (!strcmp(argv[1], "-pbm"))
+			params.pbm = true;
+		else if (!strcmp(argv[1], "-raw"))
+			params.compressed = false;
+		else if (argc > 3 && !strcmp(argv[1], "-size"))
+		{
+			if (sscanf(argv[2], "%ux%u", &params.width, &params.height) != 2)
+			{
+				printUsage();
+				return -1;
+			}
+			argv++;
+			argc--;
+		}
+		else if (argc > 3 && !strcmp(argv[1], "-depth"))
+		{
+			params.depth = (uint) atoi(argv[2]);
+			argv++;
+			argc--;
+		}
+		else if (argc > 3 && !strcmp(argv[1], "-run"))
+		{
+			params.runLength = (uint) atoi(argv[2]);
+			argv++;
+			argc--;
+		}
+		else if (argc > 3 && !strcmp(argv[1], "-ranges"))
+		{
+			params.numColorRanges = (uint) atoi(argv[2]);
+			argv++;
+			argc--;
+		}
+		else if (argc > 3 && !strcmp(argv[1], "-seed"))
+		{
+			params.seed = (uint32_t) strtoul(argv[2], 0, 0);
+			argv++;
+			argc--;
+		}
+		else
+			break;
+
+		argv++;
+		argc--;
+	}
+
+	if (argc != 2)
+	{
+		printUsage();
+		return 0;
+	}
+
+	char description[256];
+	formatSyntheticImageParams(description, sizeof description, &params);
+
+	size_t size;
+	void* data = createSyntheticImage(&params, &size);
+	if (!data)
+	{
+		printf("Unable to create %s; depth must be 1-8, and there can be at most 16 ranges, and no more than half as many as colors\n", description);
+		return -1;
+	}
+
+	FILE* fileHandle = fopen(argv[1], "wb");
+	bool succeeded = fileHandle && fwrite(data, size, 1, fileHandle) == 1;
+	if (fileHandle && fclose(fileHandle))
+		succeeded = false;
+	free(data);
+
+	if (!succeeded)
+	{
+		printf("Unable to write %s\n", argv[1]);
+		return -1;
+	}
+
+	printf("Wrote %s, %u bytes: %s\n", argv[1], (uint) size, description);
+	return 0;
+}
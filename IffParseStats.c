@@ -0,0 +1,91 @@
+
+#include "IffParseStats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void initIffParseStats(IffParseStats* stats)
+{
+	memset(stats, 0, sizeof *stats);
+}
+
+static void formatChunkId(char* buffer, uint32_t id)
+{
+	if (id)
+		sprintf(buffer, "%c%c%c%c", (char) (id >> 24), (char) (id >> 16), (char) (id >> 8), (char) id);
+	else
+		sprintf(buffer, "other");
+}
+
+static IffChunkTypeStats* findChunkTypeStats(IffParseStats* stats, uint32_t id)
+{
+	for (uint index = 0; index < stats->numChunkTypes; ++index)
+		if (stats->chunkTypes[index].id == id)
+			return &stats->chunkTypes[index];
+
+	// The last slot is kept for the chunk types which do not fit
+	if (stats->numChunkTypes == MaxIffParseStatsChunkTypes - 1)
+		id = 0;
+	else if (stats->numChunkTypes == MaxIffParseStatsChunkTypes)
+		return &stats->chunkTypes[MaxIffParseStatsChunkTypes - 1];
+
+	IffChunkTypeStats* chunkType = &stats->chunkTypes[stats->numChunkTypes++];
+	memset(chunkType, 0, sizeof *chunkType);
+	chunkType->id = id;
+	return chunkType;
+}
+
+void collectIffChunkTiming(void* context, const IffChunkTiming* timing)
+{
+	IffParseStats* stats = (IffParseStats*) context;
+	IffChunkTypeStats* chunkType = findChunkTypeStats(stats, timing->id);
+
+	chunkType->numChunks++;
+	if (!timing->succeeded)
+		chunkType->numFailedChunks++;
+	chunkType->numBytes += timing->size;
+	chunkType->readTicks += timing->readTicks;
+	chunkType->allocateTicks += timing->allocateTicks;
+	chunkType->handlerTicks += timing->handlerTicks;
+
+	if (stats->trace)
+	{
+		char id[8];
+		formatChunkId(id, timing->id);
+		printf("%s chunk at offset %u, %u bytes%s%s: read %.1f us, allocate %.1f us, handler %.1f us\n", id,
+			timing->fileOffset, timing->size, timing->handled ? "" : ", not handled", timing->succeeded ? "" : ", failed",
+			timerTicksToMicroseconds(timing->readTicks), timerTicksToMicroseconds(timing->allocateTicks),
+			timerTicksToMicroseconds(timing->handlerTicks));
+	}
+}
+
+void printIffParseStats(const IffParseStats* stats)
+{
+	IffChunkTypeStats total;
+	memset(&total, 0, sizeof total);
+
+	printf("  %-6s %7s %10s %12s %12s %12s\n", "chunk", "count", "bytes", "read us", "allocate us", "handler us");
+	for (uint index = 0; index <= stats->numChunkTypes; ++index)
+	{
+		const IffChunkTypeStats* chunkType = (index < stats->numChunkTypes) ? &stats->chunkTypes[index] : &total;
+		char id[8];
+
+		if (index < stats->numChunkTypes)
+		{
+			formatChunkId(id, chunkType->id);
+			total.numChunks += chunkType->numChunks;
+			total.numFailedChunks += chunkType->numFailedChunks;
+			if (chunkType->id != ID_FORM)	// The FORM already spans all the others
+				total.numBytes += chunkType->numBytes;
+			total.readTicks += chunkType->readTicks;
+			total.allocateTicks += chunkType->allocateTicks;
+			total.handlerTicks += chunkType->handlerTicks;
+		}
+		else
+			strcpy(id, "total");
+
+		printf("  %-6s %7u %10u %12.1f %12.1f %12.1f%s\n", id, chunkType->numChunks, (uint) chunkType->numBytes,
+			timerTicksToMicroseconds(chunkType->readTicks), timerTicksToMicroseconds(chunkType->allocateTicks),
+			timerTicksToMicroseconds(chunkType->handlerTicks), chunkType->numFailedChunks ? "  (some failed)" : "");
+	}
+}
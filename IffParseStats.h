@@ -0,0 +1,40 @@
+
+#ifndef IFFPARSESTATS_H
+#define IFFPARSESTATS_H
+
+#include "Types.h"
+#include "parseIff.h"
+
+// Collects the chunk events of one or more parses into totals per chunk type, to tell whether
+//  loading is held up by reading the file or by handling the chunks. Set chunkEndFunc to
+//  collectIffChunkTiming and chunkEventContext to the stats, either in IffParseRules or in
+//  LoadIffImageOptions.
+
+enum { MaxIffParseStatsChunkTypes = 16 };
+
+typedef struct
+{
+	uint32_t id;	// 0 collects all chunk types beyond MaxIffParseStatsChunkTypes - 1
+	uint numChunks;
+	uint numFailedChunks;
+	uint64_t numBytes;
+	TimerTicks readTicks;
+	TimerTicks allocateTicks;
+	TimerTicks handlerTicks;
+} IffChunkTypeStats;
+
+typedef struct
+{
+	bool trace;	// Also print every chunk as it ends
+	uint numChunkTypes;
+	IffChunkTypeStats chunkTypes[MaxIffParseStatsChunkTypes];
+} IffParseStats;
+
+void initIffParseStats(IffParseStats* stats);
+
+// An IffChunkEndFunc; context is the IffParseStats
+void collectIffChunkTiming(void* context, const IffChunkTiming* timing);
+
+void printIffParseStats(const IffParseStats* stats);
+
+#endif
@@ -1,6 +1,10 @@
 
 #include "Ilbm.h"
 #include "parseIff.h"
+#include "ByteRun1.h"
+#include "ChunkyToPlanar.h"
+#include "PlanarToChunky.h"
+#include "Thread.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -54,86 +58,252 @@ typedef enum
 	PixelFormat_Pbm,
 } PixelFormat;
 	
+typedef enum
+{
+	RleStreamState_Count,
+	RleStreamState_Literal,
+	RleStreamState_RepeatValue,
+} RleStreamState;
+
+// Where a streamed BODY decode left off; a row consists of one part per plane
+//  (plus the mask plane) for ILBM, and of one single chunky part for PBM
+typedef struct
+{
+	uint row;
+	uint rowPart;
+	uint rowPartBytesDecoded;
+	RleStreamState rleState;
+	uint runBytesLeft;
+	bool skip;
+} BodyStreamPosition;
+
 typedef struct
 {
 	IffErrorFunc errorFunc;
+	void* errorContext;
+	IffErrorLocation location;
+	const Allocator* allocator;
 	Ilbm* ilbm;
 	bool encounteredBMHD;
 	bool encounteredBODY;
 	uint compression;
 	bool hasMaskPlane;
 	PixelFormat pixelFormat;
-	uint8_t* pbmRowBuffer;
+	bool chunkyOutput;
+	bool interleaved;
+	uint8_t* rowBuffer;
+	ChunkyToPlanarRowFunc chunkyToPlanarRow;
+	PlanarToChunkyRowFunc planarToChunkyRow;
+	BodyStreamPosition bodyStream;
+	uint numDecodeThreads;
+	IlbmDestinationFunc destinationFunc;
+	void* destinationContext;
+	Ilbm* previousIlbm;
+	bool reusePixels;
 
 } LoadIffImageState;
 
-LoadIffImageState loadIffImageState;
+static void reportError(const LoadIffImageState* state, const char* message)
+{
+	state->errorFunc(state->errorContext, &state->location, message);
+}
 
-static uint decodeRLE(uint8_t* dest, uint8_t* src, uint destBytes)
+// CRC-32 as in zlib and PNG. Four bytes are taken at a time through four tables, but the result
+//  is that of taking one byte at a time, so a chunk hashes the same however it is cut into
+//  windows; unlike a multiplicative hash it needs no 64-bit arithmetic on the 68060.
+static const uint32_t FingerprintCrcTables[4][256] =
 {
-	uint8_t* srcStart = src;
-	uint8_t* destEnd = dest + destBytes;
+	{
+		0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
+		0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988, 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
+		0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
+		0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
+		0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172, 0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,
+		0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
+		0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f,
+		0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924, 0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
+		0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
+		0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
+		0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e, 0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
+		0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
+		0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb,
+		0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0, 0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
+		0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
+		0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
+		0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a, 0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683,
+		0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
+		0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7,
+		0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc, 0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
+		0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
+		0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
+		0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236, 0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f,
+		0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
+		0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713,
+		0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38, 0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
+		0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
+		0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
+		0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2, 0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db,
+		0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
+		0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
+		0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
+	},
+	{
+		0x00000000, 0x191b3141, 0x32366282, 0x2b2d53c3, 0x646cc504, 0x7d77f445, 0x565aa786, 0x4f4196c7,
+		0xc8d98a08, 0xd1c2bb49, 0xfaefe88a, 0xe3f4d9cb, 0xacb54f0c, 0xb5ae7e4d, 0x9e832d8e, 0x87981ccf,
+		0x4ac21251, 0x53d92310, 0x78f470d3, 0x61ef4192, 0x2eaed755, 0x37b5e614, 0x1c98b5d7, 0x05838496,
+		0x821b9859, 0x9b00a918, 0xb02dfadb, 0xa936cb9a, 0xe6775d5d, 0xff6c6c1c, 0xd4413fdf, 0xcd5a0e9e,
+		0x958424a2, 0x8c9f15e3, 0xa7b24620, 0xbea97761, 0xf1e8e1a6, 0xe8f3d0e7, 0xc3de8324, 0xdac5b265,
+		0x5d5daeaa, 0x44469feb, 0x6f6bcc28, 0x7670fd69, 0x39316bae, 0x202a5aef, 0x0b07092c, 0x121c386d,
+		0xdf4636f3, 0xc65d07b2, 0xed705471, 0xf46b6530, 0xbb2af3f7, 0xa231c2b6, 0x891c9175, 0x9007a034,
+		0x179fbcfb, 0x0e848dba, 0x25a9de79, 0x3cb2ef38, 0x73f379ff, 0x6ae848be, 0x41c51b7d, 0x58de2a3c,
+		0xf0794f05, 0xe9627e44, 0xc24f2d87, 0xdb541cc6, 0x94158a01, 0x8d0ebb40, 0xa623e883, 0xbf38d9c2,
+		0x38a0c50d, 0x21bbf44c, 0x0a96a78f, 0x138d96ce, 0x5ccc0009, 0x45d73148, 0x6efa628b, 0x77e153ca,
+		0xbabb5d54, 0xa3a06c15, 0x888d3fd6, 0x91960e97, 0xded79850, 0xc7cca911, 0xece1fad2, 0xf5facb93,
+		0x7262d75c, 0x6b79e61d, 0x4054b5de, 0x594f849f, 0x160e1258, 0x0f152319, 0x243870da, 0x3d23419b,
+		0x65fd6ba7, 0x7ce65ae6, 0x57cb0925, 0x4ed03864, 0x0191aea3, 0x188a9fe2, 0x33a7cc21, 0x2abcfd60,
+		0xad24e1af, 0xb43fd0ee, 0x9f12832d, 0x8609b26c, 0xc94824ab, 0xd05315ea, 0xfb7e4629, 0xe2657768,
+		0x2f3f79f6, 0x362448b7, 0x1d091b74, 0x04122a35, 0x4b53bcf2, 0x52488db3, 0x7965de70, 0x607eef31,
+		0xe7e6f3fe, 0xfefdc2bf, 0xd5d0917c, 0xcccba03d, 0x838a36fa, 0x9a9107bb, 0xb1bc5478, 0xa8a76539,
+		0x3b83984b, 0x2298a90a, 0x09b5fac9, 0x10aecb88, 0x5fef5d4f, 0x46f46c0e, 0x6dd93fcd, 0x74c20e8c,
+		0xf35a1243, 0xea412302, 0xc16c70c1, 0xd8774180, 0x9736d747, 0x8e2de606, 0xa500b5c5, 0xbc1b8484,
+		0x71418a1a, 0x685abb5b, 0x4377e898, 0x5a6cd9d9, 0x152d4f1e, 0x0c367e5f, 0x271b2d9c, 0x3e001cdd,
+		0xb9980012, 0xa0833153, 0x8bae6290, 0x92b553d1, 0xddf4c516, 0xc4eff457, 0xefc2a794, 0xf6d996d5,
+		0xae07bce9, 0xb71c8da8, 0x9c31de6b, 0x852aef2a, 0xca6b79ed, 0xd37048ac, 0xf85d1b6f, 0xe1462a2e,
+		0x66de36e1, 0x7fc507a0, 0x54e85463, 0x4df36522, 0x02b2f3e5, 0x1ba9c2a4, 0x30849167, 0x299fa026,
+		0xe4c5aeb8, 0xfdde9ff9, 0xd6f3cc3a, 0xcfe8fd7b, 0x80a96bbc, 0x99b25afd, 0xb29f093e, 0xab84387f,
+		0x2c1c24b0, 0x350715f1, 0x1e2a4632, 0x07317773, 0x4870e1b4, 0x516bd0f5, 0x7a468336, 0x635db277,
+		0xcbfad74e, 0xd2e1e60f, 0xf9ccb5cc, 0xe0d7848d, 0xaf96124a, 0xb68d230b, 0x9da070c8, 0x84bb4189,
+		0x03235d46, 0x1a386c07, 0x31153fc4, 0x280e0e85, 0x674f9842, 0x7e54a903, 0x5579fac0, 0x4c62cb81,
+		0x8138c51f, 0x9823f45e, 0xb30ea79d, 0xaa1596dc, 0xe554001b, 0xfc4f315a, 0xd7626299, 0xce7953d8,
+		0x49e14f17, 0x50fa7e56, 0x7bd72d95, 0x62cc1cd4, 0x2d8d8a13, 0x3496bb52, 0x1fbbe891, 0x06a0d9d0,
+		0x5e7ef3ec, 0x4765c2ad, 0x6c48916e, 0x7553a02f, 0x3a1236e8, 0x230907a9, 0x0824546a, 0x113f652b,
+		0x96a779e4, 0x8fbc48a5, 0xa4911b66, 0xbd8a2a27, 0xf2cbbce0, 0xebd08da1, 0xc0fdde62, 0xd9e6ef23,
+		0x14bce1bd, 0x0da7d0fc, 0x268a833f, 0x3f91b27e, 0x70d024b9, 0x69cb15f8, 0x42e6463b, 0x5bfd777a,
+		0xdc656bb5, 0xc57e5af4, 0xee530937, 0xf7483876, 0xb809aeb1, 0xa1129ff0, 0x8a3fcc33, 0x9324fd72,
+	},
+	{
+		0x00000000, 0x01c26a37, 0x0384d46e, 0x0246be59, 0x0709a8dc, 0x06cbc2eb, 0x048d7cb2, 0x054f1685,
+		0x0e1351b8, 0x0fd13b8f, 0x0d9785d6, 0x0c55efe1, 0x091af964, 0x08d89353, 0x0a9e2d0a, 0x0b5c473d,
+		0x1c26a370, 0x1de4c947, 0x1fa2771e, 0x1e601d29, 0x1b2f0bac, 0x1aed619b, 0x18abdfc2, 0x1969b5f5,
+		0x1235f2c8, 0x13f798ff, 0x11b126a6, 0x10734c91, 0x153c5a14, 0x14fe3023, 0x16b88e7a, 0x177ae44d,
+		0x384d46e0, 0x398f2cd7, 0x3bc9928e, 0x3a0bf8b9, 0x3f44ee3c, 0x3e86840b, 0x3cc03a52, 0x3d025065,
+		0x365e1758, 0x379c7d6f, 0x35dac336, 0x3418a901, 0x3157bf84, 0x3095d5b3, 0x32d36bea, 0x331101dd,
+		0x246be590, 0x25a98fa7, 0x27ef31fe, 0x262d5bc9, 0x23624d4c, 0x22a0277b, 0x20e69922, 0x2124f315,
+		0x2a78b428, 0x2bbade1f, 0x29fc6046, 0x283e0a71, 0x2d711cf4, 0x2cb376c3, 0x2ef5c89a, 0x2f37a2ad,
+		0x709a8dc0, 0x7158e7f7, 0x731e59ae, 0x72dc3399, 0x7793251c, 0x76514f2b, 0x7417f172, 0x75d59b45,
+		0x7e89dc78, 0x7f4bb64f, 0x7d0d0816, 0x7ccf6221, 0x798074a4, 0x78421e93, 0x7a04a0ca, 0x7bc6cafd,
+		0x6cbc2eb0, 0x6d7e4487, 0x6f38fade, 0x6efa90e9, 0x6bb5866c, 0x6a77ec5b, 0x68315202, 0x69f33835,
+		0x62af7f08, 0x636d153f, 0x612bab66, 0x60e9c151, 0x65a6d7d4, 0x6464bde3, 0x662203ba, 0x67e0698d,
+		0x48d7cb20, 0x4915a117, 0x4b531f4e, 0x4a917579, 0x4fde63fc, 0x4e1c09cb, 0x4c5ab792, 0x4d98dda5,
+		0x46c49a98, 0x4706f0af, 0x45404ef6, 0x448224c1, 0x41cd3244, 0x400f5873, 0x4249e62a, 0x438b8c1d,
+		0x54f16850, 0x55330267, 0x5775bc3e, 0x56b7d609, 0x53f8c08c, 0x523aaabb, 0x507c14e2, 0x51be7ed5,
+		0x5ae239e8, 0x5b2053df, 0x5966ed86, 0x58a487b1, 0x5deb9134, 0x5c29fb03, 0x5e6f455a, 0x5fad2f6d,
+		0xe1351b80, 0xe0f771b7, 0xe2b1cfee, 0xe373a5d9, 0xe63cb35c, 0xe7fed96b, 0xe5b86732, 0xe47a0d05,
+		0xef264a38, 0xeee4200f, 0xeca29e56, 0xed60f461, 0xe82fe2e4, 0xe9ed88d3, 0xebab368a, 0xea695cbd,
+		0xfd13b8f0, 0xfcd1d2c7, 0xfe976c9e, 0xff5506a9, 0xfa1a102c, 0xfbd87a1b, 0xf99ec442, 0xf85cae75,
+		0xf300e948, 0xf2c2837f, 0xf0843d26, 0xf1465711, 0xf4094194, 0xf5cb2ba3, 0xf78d95fa, 0xf64fffcd,
+		0xd9785d60, 0xd8ba3757, 0xdafc890e, 0xdb3ee339, 0xde71f5bc, 0xdfb39f8b, 0xddf521d2, 0xdc374be5,
+		0xd76b0cd8, 0xd6a966ef, 0xd4efd8b6, 0xd52db281, 0xd062a404, 0xd1a0ce33, 0xd3e6706a, 0xd2241a5d,
+		0xc55efe10, 0xc49c9427, 0xc6da2a7e, 0xc7184049, 0xc25756cc, 0xc3953cfb, 0xc1d382a2, 0xc011e895,
+		0xcb4dafa8, 0xca8fc59f, 0xc8c97bc6, 0xc90b11f1, 0xcc440774, 0xcd866d43, 0xcfc0d31a, 0xce02b92d,
+		0x91af9640, 0x906dfc77, 0x922b422e, 0x93e92819, 0x96a63e9c, 0x976454ab, 0x9522eaf2, 0x94e080c5,
+		0x9fbcc7f8, 0x9e7eadcf, 0x9c381396, 0x9dfa79a1, 0x98b56f24, 0x99770513, 0x9b31bb4a, 0x9af3d17d,
+		0x8d893530, 0x8c4b5f07, 0x8e0de15e, 0x8fcf8b69, 0x8a809dec, 0x8b42f7db, 0x89044982, 0x88c623b5,
+		0x839a6488, 0x82580ebf, 0x801eb0e6, 0x81dcdad1, 0x8493cc54, 0x8551a663, 0x8717183a, 0x86d5720d,
+		0xa9e2d0a0, 0xa820ba97, 0xaa6604ce, 0xaba46ef9, 0xaeeb787c, 0xaf29124b, 0xad6fac12, 0xacadc625,
+		0xa7f18118, 0xa633eb2f, 0xa4755576, 0xa5b73f41, 0xa0f829c4, 0xa13a43f3, 0xa37cfdaa, 0xa2be979d,
+		0xb5c473d0, 0xb40619e7, 0xb640a7be, 0xb782cd89, 0xb2cddb0c, 0xb30fb13b, 0xb1490f62, 0xb08b6555,
+		0xbbd72268, 0xba15485f, 0xb853f606, 0xb9919c31, 0xbcde8ab4, 0xbd1ce083, 0xbf5a5eda, 0xbe9834ed,
+	},
+	{
+		0x00000000, 0xb8bc6765, 0xaa09c88b, 0x12b5afee, 0x8f629757, 0x37def032, 0x256b5fdc, 0x9dd738b9,
+		0xc5b428ef, 0x7d084f8a, 0x6fbde064, 0xd7018701, 0x4ad6bfb8, 0xf26ad8dd, 0xe0df7733, 0x58631056,
+		0x5019579f, 0xe8a530fa, 0xfa109f14, 0x42acf871, 0xdf7bc0c8, 0x67c7a7ad, 0x75720843, 0xcdce6f26,
+		0x95ad7f70, 0x2d111815, 0x3fa4b7fb, 0x8718d09e, 0x1acfe827, 0xa2738f42, 0xb0c620ac, 0x087a47c9,
+		0xa032af3e, 0x188ec85b, 0x0a3b67b5, 0xb28700d0, 0x2f503869, 0x97ec5f0c, 0x8559f0e2, 0x3de59787,
+		0x658687d1, 0xdd3ae0b4, 0xcf8f4f5a, 0x7733283f, 0xeae41086, 0x525877e3, 0x40edd80d, 0xf851bf68,
+		0xf02bf8a1, 0x48979fc4, 0x5a22302a, 0xe29e574f, 0x7f496ff6, 0xc7f50893, 0xd540a77d, 0x6dfcc018,
+		0x359fd04e, 0x8d23b72b, 0x9f9618c5, 0x272a7fa0, 0xbafd4719, 0x0241207c, 0x10f48f92, 0xa848e8f7,
+		0x9b14583d, 0x23a83f58, 0x311d90b6, 0x89a1f7d3, 0x1476cf6a, 0xaccaa80f, 0xbe7f07e1, 0x06c36084,
+		0x5ea070d2, 0xe61c17b7, 0xf4a9b859, 0x4c15df3c, 0xd1c2e785, 0x697e80e0, 0x7bcb2f0e, 0xc377486b,
+		0xcb0d0fa2, 0x73b168c7, 0x6104c729, 0xd9b8a04c, 0x446f98f5, 0xfcd3ff90, 0xee66507e, 0x56da371b,
+		0x0eb9274d, 0xb6054028, 0xa4b0efc6, 0x1c0c88a3, 0x81dbb01a, 0x3967d77f, 0x2bd27891, 0x936e1ff4,
+		0x3b26f703, 0x839a9066, 0x912f3f88, 0x299358ed, 0xb4446054, 0x0cf80731, 0x1e4da8df, 0xa6f1cfba,
+		0xfe92dfec, 0x462eb889, 0x549b1767, 0xec277002, 0x71f048bb, 0xc94c2fde, 0xdbf98030, 0x6345e755,
+		0x6b3fa09c, 0xd383c7f9, 0xc1366817, 0x798a0f72, 0xe45d37cb, 0x5ce150ae, 0x4e54ff40, 0xf6e89825,
+		0xae8b8873, 0x1637ef16, 0x048240f8, 0xbc3e279d, 0x21e91f24, 0x99557841, 0x8be0d7af, 0x335cb0ca,
+		0xed59b63b, 0x55e5d15e, 0x47507eb0, 0xffec19d5, 0x623b216c, 0xda874609, 0xc832e9e7, 0x708e8e82,
+		0x28ed9ed4, 0x9051f9b1, 0x82e4565f, 0x3a58313a, 0xa78f0983, 0x1f336ee6, 0x0d86c108, 0xb53aa66d,
+		0xbd40e1a4, 0x05fc86c1, 0x1749292f, 0xaff54e4a, 0x322276f3, 0x8a9e1196, 0x982bbe78, 0x2097d91d,
+		0x78f4c94b, 0xc048ae2e, 0xd2fd01c0, 0x6a4166a5, 0xf7965e1c, 0x4f2a3979, 0x5d9f9697, 0xe523f1f2,
+		0x4d6b1905, 0xf5d77e60, 0xe762d18e, 0x5fdeb6eb, 0xc2098e52, 0x7ab5e937, 0x680046d9, 0xd0bc21bc,
+		0x88df31ea, 0x3063568f, 0x22d6f961, 0x9a6a9e04, 0x07bda6bd, 0xbf01c1d8, 0xadb46e36, 0x15080953,
+		0x1d724e9a, 0xa5ce29ff, 0xb77b8611, 0x0fc7e174, 0x9210d9cd, 0x2aacbea8, 0x38191146, 0x80a57623,
+		0xd8c66675, 0x607a0110, 0x72cfaefe, 0xca73c99b, 0x57a4f122, 0xef189647, 0xfdad39a9, 0x45115ecc,
+		0x764dee06, 0xcef18963, 0xdc44268d, 0x64f841e8, 0xf92f7951, 0x41931e34, 0x5326b1da, 0xeb9ad6bf,
+		0xb3f9c6e9, 0x0b45a18c, 0x19f00e62, 0xa14c6907, 0x3c9b51be, 0x842736db, 0x96929935, 0x2e2efe50,
+		0x2654b999, 0x9ee8defc, 0x8c5d7112, 0x34e11677, 0xa9362ece, 0x118a49ab, 0x033fe645, 0xbb838120,
+		0xe3e09176, 0x5b5cf613, 0x49e959fd, 0xf1553e98, 0x6c820621, 0xd43e6144, 0xc68bceaa, 0x7e37a9cf,
+		0xd67f4138, 0x6ec3265d, 0x7c7689b3, 0xc4caeed6, 0x591dd66f, 0xe1a1b10a, 0xf3141ee4, 0x4ba87981,
+		0x13cb69d7, 0xab770eb2, 0xb9c2a15c, 0x017ec639, 0x9ca9fe80, 0x241599e5, 0x36a0360b, 0x8e1c516e,
+		0x866616a7, 0x3eda71c2, 0x2c6fde2c, 0x94d3b949, 0x090481f0, 0xb1b8e695, 0xa30d497b, 0x1bb12e1e,
+		0x43d23e48, 0xfb6e592d, 0xe9dbf6c3, 0x516791a6, 0xccb0a91f, 0x740cce7a, 0x66b96194, 0xde0506f1,
+	},
+};
 
-#ifdef DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE
-	printf("DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE: Decoding RLE datastream: output %u bytes\n", destBytes);
-#endif
-	
-	while (dest != destEnd)
+enum { FingerprintHashBasis = 0 };
+
+static uint32_t updateFingerprintHash(uint32_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*) data;
+	const uint8_t* wordsEnd = bytes + (size & ~(size_t) 3);
+	const uint8_t* end = bytes + size;
+
+	hash = ~hash;
+	for (; bytes != wordsEnd; bytes += 4)
 	{
-		int8_t count = *src++;
-#ifdef DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE
-		printf("DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE:  count = %d\n", count);
-#endif
-		if (count >= 0)
-		{
-			while (count-- != -1)
-			{
-				*dest++ = *src++;
-			}
-		}
-		else if (count != -128)
-		{
-			uint8_t value = *src++;
-			while (count++ != 1)
-			{
-				*dest++ = value;
-			}
-			
-		}
-		// count == 128 is a no-op
+		hash ^= bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+		hash = FingerprintCrcTables[3][hash & 0xff] ^ FingerprintCrcTables[2][(hash >> 8) & 0xff]
+			^ FingerprintCrcTables[1][(hash >> 16) & 0xff] ^ FingerprintCrcTables[0][hash >> 24];
 	}
-	
-	return (src - srcStart);
+	for (; bytes != end; ++bytes)
+		hash = FingerprintCrcTables[0][(hash ^ *bytes) & 0xff] ^ (hash >> 8);
+
+	return ~hash;
 }
 
-static uint skipRLE(uint8_t* src, uint destBytes)
+static bool fingerprintsEqual(const IlbmChunkFingerprint* a, const IlbmChunkFingerprint* b)
 {
-	uint8_t* srcStart = src;
+	return a->size == b->size && a->hash == b->hash;
+}
 
-#ifdef DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE
-	printf("DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE: Skipping RLE datastream: output %u bytes\n", destBytes);
-#endif
+// The chunk contents are big-endian and are decoded field by field, so that
+//  loading works the same on any host byte order
 
-	while (destBytes)
-	{
-		int8_t count = *src++;
-#ifdef DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE
-		printf("DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE:  count = %d\n", count);
-#endif
-		if (count >= 0)
-		{
-			src += (count + 1);
-			destBytes -= (count + 1);
-		}
-		else if (count != -128)
-		{
-			src++;
-			destBytes -= (-count + 1);
-		}
-		// count == 128 is a no-op
-	}
-	
-	return (src - srcStart);
+static void decodeBitMapHeader(BitMapHeader* header, const uint8_t* source)
+{
+	header->w = readIffUint16(source + 0);
+	header->h = readIffUint16(source + 2);
+	header->x = (int16_t) readIffUint16(source + 4);
+	header->y = (int16_t) readIffUint16(source + 6);
+	header->nPlanes = source[8];
+	header->masking = source[9];
+	header->compression = source[10];
+	header->pad1 = source[11];
+	header->transparentColor = readIffUint16(source + 12);
+	header->xAspect = source[14];
+	header->yAspect = source[15];
+	header->pageWidth = readIffUint16(source + 16);
+	header->pageHeight = readIffUint16(source + 18);
+}
+
+static void decodeCRange(CRange* range, const uint8_t* source)
+{
+	range->pad1 = readIffUint16(source + 0);
+	range->rate = readIffUint16(source + 2);
+	range->flags = readIffUint16(source + 4);
+	range->low = source[6];
+	range->high = source[7];
 }
 
 static bool handleILBM(void* state_, void* buffer, unsigned int size)
@@ -153,37 +323,41 @@ static bool handlePBM(void* state_, void* buffer, unsigned int size)
 static bool handleBMHD(void* state_, void* buffer, unsigned int size)
 {
 	LoadIffImageState* state = (LoadIffImageState*) state_;
-	if (size != sizeof BitMapHeader)
+	if (size != sizeof(BitMapHeader))
 	{
-		state->errorFunc("Invalid BMHD size");
+		reportError(state, "Invalid BMHD size");
 		return false;
 	}
 
-	BitMapHeader* header = (BitMapHeader*) buffer;
+	BitMapHeader header;
+	decodeBitMapHeader(&header, (const uint8_t*) buffer);
 	
 	state->encounteredBMHD = true;
 	Ilbm* ilbm = state->ilbm;
-	ilbm->width = header->w;
-	ilbm->height = header->h;
-	ilbm->depth = header->nPlanes;
-	ilbm->bytesPerRow = ((header->w + 15) / 16) * 2;
+	uint32_t pixelFormat = state->pixelFormat;
+	ilbm->bmhdFingerprint.size = size;
+	ilbm->bmhdFingerprint.hash = updateFingerprintHash(updateFingerprintHash(FingerprintHashBasis, &pixelFormat, sizeof pixelFormat), buffer, size);
+	ilbm->width = header.w;
+	ilbm->height = header.h;
+	ilbm->depth = header.nPlanes;
+	ilbm->bytesPerRow = ((header.w + 15) / 16) * 2;
 
-	switch (header->compression)
+	switch (header.compression)
 	{
 		case cmpNone:
 		case cmpByteRun1:
-			state->compression = header->compression;
+			state->compression = header.compression;
 			break;
 		default:
 			{
 				char buf[1024];
-				sprintf(buf, "Unknown compression type %u", header->compression);
-				state->errorFunc(buf);
+				sprintf(buf, "Unknown compression type %u", header.compression);
+				reportError(state, buf);
 				return false;
 			}
 	}
 
-	state->hasMaskPlane = (header->masking == mskHasMask);
+	state->hasMaskPlane = (header.masking == mskHasMask);
 
 #ifdef DEBUG_IFF_IMAGE_PARSER
 	printf("DEBUG_IFF_IMAGE_PARSER: Image dimensions: %ux%u pixels, %u bits per pixel%s\n", ilbm->width, ilbm->height, ilbm->depth, (state->hasMaskPlane ? " (+ 1 mask bitplane)" : ""));
@@ -194,7 +368,7 @@ static bool handleBMHD(void* state_, void* buffer, unsigned int size)
 	{
 		char buf[1024];
 		sprintf(buf, "Parser does not support more than %u bits per pixel", (uint) MaxIlbmPlanes);
-		state->errorFunc(buf);
+		reportError(state, buf);
 		return false;
 	}
 
@@ -208,7 +382,7 @@ static bool handleCMAP(void* state_, void* buffer, unsigned int size)
 	
 	if (size % 3)
 	{
-		state->errorFunc("CMAP chunk size must be an even multiple of 3 bytes");
+		reportError(state, "CMAP chunk size must be an even multiple of 3 bytes");
 		return false;
 	}
 	
@@ -233,39 +407,48 @@ static bool handleCRNG(void* state_, void* buffer, unsigned int size)
 	LoadIffImageState* state = (LoadIffImageState*) state_;
 	Ilbm* ilbm = state->ilbm;
 	
-	if (size != sizeof CRange)
+	if (size != sizeof(CRange))
 	{
 		char buf[1024];
-		sprintf(buf, "CRNG chunk must be %u bytes", (uint) sizeof CRange);
-		state->errorFunc(buf);
+		sprintf(buf, "CRNG chunk must be %u bytes", (uint) sizeof(CRange));
+		reportError(state, buf);
 		return false;
 	}
 
 
-	CRange* sourceRange = (CRange*) buffer;
+	CRange sourceRange;
+	decodeCRange(&sourceRange, (const uint8_t*) buffer);
 	
-	if (!(sourceRange->flags & RNG_ACTIVE))
+	if (!(sourceRange.flags & RNG_ACTIVE))
 	{
 #ifdef DEBUG_IFF_IMAGE_PARSER
 		printf("DEBUG_IFF_IMAGE_PARSER: Ignoring inactive color range\n");
 #endif
 		return true;
 	}
+
+	if (sourceRange.high < sourceRange.low)
+	{
+#ifdef DEBUG_IFF_IMAGE_PARSER
+		printf("DEBUG_IFF_IMAGE_PARSER: Ignoring color range which ends before it starts\n");
+#endif
+		return true;
+	}
 	
 	if (ilbm->numColorRanges == MaxIlbmColorRanges)
 	{
 		char buf[1024];
 		sprintf(buf, "Parser supports at most %u active color ranges in a file", (uint) MaxIlbmColorRanges);
-		state->errorFunc(buf);
+		reportError(state, buf);
 		return false;
 	}
 
 	IlbmColorRange* destRange = &ilbm->colorRanges[ilbm->numColorRanges];
 
-	destRange->low = (uint) sourceRange->low;
-	destRange->high = (uint) sourceRange->high;
-	destRange->rate = sourceRange->rate;
-	destRange->reverse = (sourceRange->flags & RNG_REVERSE) ? true : false;
+	destRange->low = (uint) sourceRange.low;
+	destRange->high = (uint) sourceRange.high;
+	destRange->rate = sourceRange.rate;
+	destRange->reverse = (sourceRange.flags & RNG_REVERSE) ? true : false;
 	
 #ifdef DEBUG_IFF_IMAGE_PARSER
 	printf("DEBUG_IFF_IMAGE_PARSER: Color range from %u to %u, rate %u%s\n", destRange->low, destRange->high, destRange->rate, destRange->reverse ? ", reverse" : "");
@@ -275,9 +458,66 @@ static bool handleCRNG(void* state_, void* buffer, unsigned int size)
 	return true;
 }
 
-static bool handleBODY(void* state_, void* buffer, unsigned int size)
+// Scratch space for one row: chunky pixels on their way to planes for PBM, or
+//  planes on their way to chunky pixels for ILBM loaded with chunky output
+static uint getRowBufferBytes(const LoadIffImageState* state)
+{
+	Ilbm* ilbm = state->ilbm;
+
+	if (state->pixelFormat == PixelFormat_Pbm)
+		return state->chunkyOutput ? 0 : (ilbm->width + 31) & ~31;
+	else
+		return state->chunkyOutput ? ilbm->depth * ilbm->bytesPerRow : 0;
+}
+
+static bool useDestination(LoadIffImageState* state, const IlbmDestination* destination)
+{
+	Ilbm* ilbm = state->ilbm;
+
+	if (destination->chunky)
+	{
+		if (destination->chunkyPitch < ilbm->width)
+		{
+			reportError(state, "Destination rows are narrower than the image");
+			return false;
+		}
+
+		ilbm->chunky = destination->chunky;
+		ilbm->chunkyPitch = destination->chunkyPitch;
+		state->chunkyOutput = true;
+		state->planarToChunkyRow = selectPlanarToChunkyRowFunc(ilbm->depth);
+	}
+	else
+	{
+		if (destination->planeRowStride < ilbm->bytesPerRow)
+		{
+			reportError(state, "Destination rows are narrower than the image");
+			return false;
+		}
+
+		ilbm->interleaved = (ilbm->depth > 1 && destination->planeRowStride == ilbm->depth * ilbm->bytesPerRow);
+		for (uint planeIndex = 0; planeIndex < ilbm->depth; ++planeIndex)
+		{
+			ilbm->planes[planeIndex].data = destination->planes[planeIndex];
+			if (destination->planes[planeIndex] != (uint8_t*) destination->planes[0] + planeIndex * ilbm->bytesPerRow)
+				ilbm->interleaved = false;
+		}
+		ilbm->planeRowStride = destination->planeRowStride;
+		state->chunkyOutput = false;
+		state->chunkyToPlanarRow = selectChunkyToPlanarRowFunc(ilbm->depth);
+	}
+
+#ifdef DEBUG_IFF_IMAGE_PARSER
+	printf("DEBUG_IFF_IMAGE_PARSER: Decoding into %s memory provided by the caller\n", destination->chunky ? "chunky" : "planar");
+#endif
+
+	ilbm->externalPixels = true;
+	return true;
+}
+
+// Prepares for decoding the first BODY chunk; sets *skip if this BODY should be ignored
+static bool beginBODY(LoadIffImageState* state, bool* skip)
 {
-	LoadIffImageState* state = (LoadIffImageState*) state_;
 	Ilbm* ilbm = state->ilbm;
 	uint bytesPerRow = ilbm->bytesPerRow;
 	uint bytesPerPlane = bytesPerRow * ilbm->height;
@@ -285,10 +525,12 @@ static bool handleBODY(void* state_, void* buffer, unsigned int size)
 
 	if (!state->encounteredBMHD)
 	{
-		state->errorFunc("Unable to decode BODY before BMHD has been handled");
+		reportError(state, "Unable to decode BODY before BMHD has been handled");
 		return false;
 	}
 	
+	*skip = state->encounteredBODY;
+
 	if (state->encounteredBODY)
 	{
 #ifdef DEBUG_IFF_IMAGE_PARSER
@@ -301,251 +543,872 @@ static bool handleBODY(void* state_, void* buffer, unsigned int size)
 	
 	if (state->pixelFormat == PixelFormat_Pbm && state->hasMaskPlane)
 	{
-		state->errorFunc("PBM format parser doesn't support mask plane");
+		reportError(state, "PBM format parser doesn't support mask plane");
 		return false;
 	}
 	
+	IlbmDestination destination = { { 0 } };
+	if (state->destinationFunc && state->destinationFunc(state->destinationContext, ilbm, &destination))
+	{
+		if (!useDestination(state, &destination))
+			return false;
+	}
+	else if (state->chunkyOutput)
+	{
+		uint chunkyBytes = ilbm->width * ilbm->height;
+
 #ifdef DEBUG_IFF_IMAGE_PARSER
-	printf("DEBUG_IFF_IMAGE_PARSER: Allocating memory for %ux%ux%u planes\n", ilbm->width, ilbm->height, ilbm->depth);
+		printf("DEBUG_IFF_IMAGE_PARSER: Allocating memory for %ux%u chunky pixels\n", ilbm->width, ilbm->height);
 #endif
 
-	if (!(ilbm->planes[0].data = malloc(bytesToAllocate)))
-	{
-		char buf[1024];
-		sprintf(buf, "Unable to allocate %u bytes", bytesToAllocate);
-		state->errorFunc(buf);
-		return false;
+		if (!(ilbm->chunky = allocateMemory(state->allocator, chunkyBytes)))
+		{
+			char buf[1024];
+			sprintf(buf, "Unable to allocate %u bytes", chunkyBytes);
+			reportError(state, buf);
+			return false;
+		}
+
+		ilbm->chunkyPitch = ilbm->width;
+		state->planarToChunkyRow = selectPlanarToChunkyRowFunc(ilbm->depth);
 	}
+	else
+	{
+#ifdef DEBUG_IFF_IMAGE_PARSER
+		printf("DEBUG_IFF_IMAGE_PARSER: Allocating memory for %ux%ux%u planes\n", ilbm->width, ilbm->height, ilbm->depth);
+#endif
+
+		if (!(ilbm->planes[0].data = allocateMemory(state->allocator, bytesToAllocate)))
+		{
+			char buf[1024];
+			sprintf(buf, "Unable to allocate %u bytes", bytesToAllocate);
+			reportError(state, buf);
+			return false;
+		}
 
-	for (uint planeIndex = 1; planeIndex < ilbm->depth; ++planeIndex)
-		ilbm->planes[planeIndex].data = (void*) ((uint8_t*) ilbm->planes[0].data + planeIndex * bytesPerPlane);
+		// Plane after plane, or plane row after plane row
+		uint planeOffset = state->interleaved ? bytesPerRow : bytesPerPlane;
+		for (uint planeIndex = 1; planeIndex < ilbm->depth; ++planeIndex)
+			ilbm->planes[planeIndex].data = (void*) ((uint8_t*) ilbm->planes[0].data + planeIndex * planeOffset);
+
+		ilbm->planeRowStride = state->interleaved ? bytesPerRow * ilbm->depth : bytesPerRow;
+		ilbm->interleaved = state->interleaved && ilbm->depth > 1;
+		state->chunkyToPlanarRow = selectChunkyToPlanarRowFunc(ilbm->depth);
+	}
 
 #ifdef DEBUG_IFF_IMAGE_PARSER
 	printf("DEBUG_IFF_IMAGE_PARSER: Decoding bitmap data\n");
 #endif
 
-	if (state->pixelFormat == PixelFormat_Pbm)
+	uint rowBufferBytes = getRowBufferBytes(state);
+	if (rowBufferBytes)
 	{
-		uint rowBufferBytes = (ilbm->width + 31) & ~31;
-		if (!(state->pbmRowBuffer = malloc(rowBufferBytes)))
+		if (!(state->rowBuffer = allocateMemory(state->allocator, rowBufferBytes)))
 		{
 			char buf[1024];
 			sprintf(buf, "Unable to allocate %u bytes", rowBufferBytes);
-			state->errorFunc(buf);
+			reportError(state, buf);
 			return false;
 		}
 		
-		memset(state->pbmRowBuffer, 0, rowBufferBytes);
+		// The padding after the last pixel stays zero, as the C2P converts whole 16-pixel groups
+		memset(state->rowBuffer, 0, rowBufferBytes);
 	}
 
-	uint8_t* sourcePtr = (uint8_t*) buffer;
-	uint8_t* sourcePtrEnd = sourcePtr + size;
-	for (uint row = 0; row < ilbm->height; ++row)
+	return true;
+}
+
+static void convertPbmRowToPlanes(const LoadIffImageState* state, uint row, uint8_t* rowBuffer)
+{
+	Ilbm* ilbm = state->ilbm;
+	uint8_t* planeRows[MaxIlbmPlanes];
+
+	if (!state->chunkyToPlanarRow)
+		return;
+
+	for (uint plane = 0; plane < ilbm->depth; ++plane)
+		planeRows[plane] = (uint8_t*) ilbm->planes[plane].data + row * ilbm->planeRowStride;
+
+	state->chunkyToPlanarRow(rowBuffer, ilbm->width, planeRows);
+}
+
+static void convertIlbmRowToChunky(const LoadIffImageState* state, uint row, uint8_t* rowBuffer)
+{
+	Ilbm* ilbm = state->ilbm;
+	uint8_t* chunkyRow = ilbm->chunky + row * ilbm->chunkyPitch;
+	const uint8_t* planeRows[MaxIlbmPlanes];
+
+	if (!state->planarToChunkyRow)
 	{
-		switch (state->pixelFormat)
+		memset(chunkyRow, 0, ilbm->width);
+		return;
+	}
+
+	for (uint plane = 0; plane < ilbm->depth; ++plane)
+		planeRows[plane] = rowBuffer + plane * ilbm->bytesPerRow;
+
+	state->planarToChunkyRow(planeRows, ilbm->width, chunkyRow);
+}
+
+static bool validateBodyFormat(LoadIffImageState* state)
+{
+	switch (state->pixelFormat)
+	{
+		case PixelFormat_Ilbm:
+		case PixelFormat_Pbm:
+			break;
+		default:
 		{
-			case PixelFormat_Ilbm:
-			{
-				for (uint plane = 0; plane < ilbm->depth; ++plane)
-				{
-					uint8_t* destPtr = (uint8_t*) ilbm->planes[plane].data + row * bytesPerRow;
-					uint8_t* destPtrEnd = destPtr + bytesPerRow;
+			char buf[1024];
+			sprintf(buf, "Unsupported pixelFormat %d", (int) state->pixelFormat);
+			reportError(state, buf);
+			return false;
+		}
+	}
+
+	if (state->compression != cmpNone && state->compression != cmpByteRun1)
+	{
+		reportError(state, "Compression method not implemented");
+		return false;
+	}
+
+	return true;
+}
+
+typedef const uint8_t* (*BodyRowDecoder)(const LoadIffImageState* state, uint row, const uint8_t* sourcePtr, const uint8_t* sourcePtrEnd, uint8_t* rowBuffer);
+
+// Decodes or skips one plane of one row, and returns a pointer to the first source byte after it,
+//  or 0 if the row does not fit in the source; dest = 0 skips
+static inline const uint8_t* decodeBodyRowPart(uint8_t* destPtr, uint bytes, const uint8_t* sourcePtr, const uint8_t* sourcePtrEnd, bool compressed)
+{
+	if (compressed)
+		return destPtr ? decodeByteRun1(destPtr, bytes, sourcePtr, sourcePtrEnd) : skipByteRun1(bytes, sourcePtr, sourcePtrEnd);
+
+	if (bytes > (uint) (sourcePtrEnd - sourcePtr))
+		return 0;
+	if (destPtr)
+		memcpy(destPtr, sourcePtr, bytes);
+	return sourcePtr + bytes;
+}
+
+// The row decoders below are all generated from these two, with every parameter after rowBuffer
+//  a constant, so that each instance is free of per-row and per-plane decisions, and the compiler
+//  can unroll the plane loop. They decode all planes of one row, and return a pointer to the first
+//  source byte of the next row, or 0 if the row does not fit in the source.
+
+static inline const uint8_t* decodeIlbmRow(const LoadIffImageState* state, uint row, const uint8_t* sourcePtr, const uint8_t* sourcePtrEnd, uint8_t* rowBuffer,
+	uint depth, bool compressed, bool hasMaskPlane, bool chunkyOutput)
+{
+	const Ilbm* ilbm = state->ilbm;
+	uint bytesPerRow = ilbm->bytesPerRow;
+	size_t planeOffset = row * ilbm->planeRowStride;
+
+	for (uint plane = 0; plane < depth; ++plane)
+	{
+		uint8_t* destPtr = chunkyOutput
+			? rowBuffer + plane * bytesPerRow
+			: (uint8_t*) ilbm->planes[plane].data + planeOffset;
 
 #ifdef DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE
-					printf("DEBUG_IFF_IMAGE_PARSER: Decoding row %u, plane %u\n", row, plane);
+		printf("DEBUG_IFF_IMAGE_PARSER: Decoding row %u, plane %u\n", row, plane);
 #endif
-					switch (state->compression)
-					{
-						case cmpNone:
-							memcpy(destPtr, sourcePtr, bytesPerRow);
-							sourcePtr += bytesPerRow;
-							break;
-						case cmpByteRun1:
-							sourcePtr += decodeRLE(destPtr, sourcePtr, bytesPerRow);
-							break;
-						default:
-							state->errorFunc("Compression method not implemented");
-							return false;
-					}
-				}
+		if (!(sourcePtr = decodeBodyRowPart(destPtr, bytesPerRow, sourcePtr, sourcePtrEnd, compressed)))
+			return 0;
+	}
 
-				if (state->hasMaskPlane)
-				{
+	if (hasMaskPlane)
+	{
 #ifdef DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE
-					printf("DEBUG_IFF_IMAGE_PARSER: Skipping over mask plane\n");
+		printf("DEBUG_IFF_IMAGE_PARSER: Skipping over mask plane\n");
 #endif
-					switch (state->compression)
-					{
-						case cmpNone:
-							sourcePtr += bytesPerRow;
-							break;
-						case cmpByteRun1:
-							sourcePtr += skipRLE(sourcePtr, bytesPerRow);
-							break;
-							return false;
-						default:
-							state->errorFunc("Compression method not implemented");
-							return false;
-					}
-				}
-				break;
-			}
-			case PixelFormat_Pbm:
-			{
+		if (!(sourcePtr = decodeBodyRowPart(0, bytesPerRow, sourcePtr, sourcePtrEnd, compressed)))
+			return 0;
+	}
+
+	if (chunkyOutput)
+		convertIlbmRowToChunky(state, row, rowBuffer);
+
+	return sourcePtr;
+}
+
+static inline const uint8_t* decodePbmRow(const LoadIffImageState* state, uint row, const uint8_t* sourcePtr, const uint8_t* sourcePtrEnd, uint8_t* rowBuffer,
+	bool compressed, bool chunkyOutput)
+{
+	const Ilbm* ilbm = state->ilbm;
+	uint8_t* destPtr = chunkyOutput ? ilbm->chunky + row * ilbm->chunkyPitch : rowBuffer;
+
 #ifdef DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE
-				printf("DEBUG_IFF_IMAGE_PARSER: Decoding row %u\n", row);
+	printf("DEBUG_IFF_IMAGE_PARSER: Decoding row %u\n", row);
 #endif
-				switch (state->compression)
-				{
-					case cmpNone:
-						memcpy(state->pbmRowBuffer, sourcePtr, ilbm->width);
-						sourcePtr += ilbm->width;
-						break;
-					case cmpByteRun1:
-						sourcePtr += decodeRLE(state->pbmRowBuffer, sourcePtr, ilbm->width);
-						break;
-					default:
-						state->errorFunc("Compression method not implemented");
-						return false;
-				}
+	if (!(sourcePtr = decodeBodyRowPart(destPtr, ilbm->width, sourcePtr, sourcePtrEnd, compressed)))
+		return 0;
+
+	if (!chunkyOutput)
+	{
 #ifdef DEBUG_IFF_IMAGE_PARSER_BITMAP_DECODE
-				printf("DEBUG_IFF_IMAGE_PARSER: C2P converting row %u\n", row);
+		printf("DEBUG_IFF_IMAGE_PARSER: C2P converting row %u\n", row);
 #endif
-				uint16_t planeData[8] = { 0 };
-				
-				for (uint offset = 0; offset < ilbm->width; offset += sizeof planeData)
-				{
-					uint bytesToCopy = ilbm->width - offset;
-					if (bytesToCopy > sizeof planeData)
-						bytesToCopy = sizeof planeData;
-					
-					memcpy(planeData, &state->pbmRowBuffer[offset], bytesToCopy);
-					uint bytesToClear = sizeof planeData - bytesToCopy;
-					if (bytesToClear)
-						memset(&state->pbmRowBuffer[offset + bytesToCopy], 0, bytesToClear);
-					
-#define MERGE16(a, b, temp, shift, mask) \
-	temp = ((b >> shift) ^ a) & mask; \
-	a ^= temp; \
-	b ^= (temp << shift);
-
-					uint16_t temp;
-					MERGE16(planeData[0], planeData[4], temp, 8, 0x00ff);
-					MERGE16(planeData[1], planeData[5], temp, 8, 0x00ff);
-					MERGE16(planeData[2], planeData[6], temp, 8, 0x00ff);
-					MERGE16(planeData[3], planeData[7], temp, 8, 0x00ff);
-					MERGE16(planeData[0], planeData[2], temp, 4, 0x0f0f);
-					MERGE16(planeData[1], planeData[3], temp, 4, 0x0f0f);
-					MERGE16(planeData[4], planeData[6], temp, 4, 0x0f0f);
-					MERGE16(planeData[5], planeData[7], temp, 4, 0x0f0f);
-					MERGE16(planeData[0], planeData[1], temp, 2, 0x3333);
-					MERGE16(planeData[2], planeData[3], temp, 2, 0x3333);
-					MERGE16(planeData[4], planeData[5], temp, 2, 0x3333);
-					MERGE16(planeData[6], planeData[7], temp, 2, 0x3333);
-					MERGE16(planeData[0], planeData[4], temp, 1, 0x5555);
-					MERGE16(planeData[1], planeData[5], temp, 1, 0x5555);
-					MERGE16(planeData[2], planeData[6], temp, 1, 0x5555);
-					MERGE16(planeData[3], planeData[7], temp, 1, 0x5555);
-
-#undef MERGE16
-
-					uint16_t shuffledPlaneData[8];
-					
-					shuffledPlaneData[7] = planeData[0];
-					shuffledPlaneData[5] = planeData[1];
-					shuffledPlaneData[3] = planeData[2];
-					shuffledPlaneData[1] = planeData[3];
-					shuffledPlaneData[6] = planeData[4];
-					shuffledPlaneData[4] = planeData[5];
-					shuffledPlaneData[2] = planeData[6];
-					shuffledPlaneData[0] = planeData[7];
-
-					for (uint plane = 0; plane < ilbm->depth; ++plane)
-					{
-						uint16_t* destPtr = (uint16_t*) ((uint8_t*) ilbm->planes[plane].data + row * bytesPerRow + (offset >> 3));
-						*destPtr = shuffledPlaneData[plane];
-					}
+		convertPbmRowToPlanes(state, row, rowBuffer);
+	}
+
+	return sourcePtr;
+}
+
+#define ILBM_ROW_DECODER_NAME(depth, compressed, hasMaskPlane, chunkyOutput) decodeIlbmRow_##depth##_##compressed##_##hasMaskPlane##_##chunkyOutput
+
+#define DEFINE_ILBM_ROW_DECODER(depth, compressed, hasMaskPlane, chunkyOutput) \
+	static const uint8_t* ILBM_ROW_DECODER_NAME(depth, compressed, hasMaskPlane, chunkyOutput)(const LoadIffImageState* state, uint row, const uint8_t* sourcePtr, const uint8_t* sourcePtrEnd, uint8_t* rowBuffer) \
+	{ \
+		return decodeIlbmRow(state, row, sourcePtr, sourcePtrEnd, rowBuffer, depth, compressed, hasMaskPlane, chunkyOutput); \
+	}
+
+#define DEFINE_ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(compressed, hasMaskPlane, chunkyOutput) \
+	DEFINE_ILBM_ROW_DECODER(0, compressed, hasMaskPlane, chunkyOutput) \
+	DEFINE_ILBM_ROW_DECODER(1, compressed, hasMaskPlane, chunkyOutput) \
+	DEFINE_ILBM_ROW_DECODER(2, compressed, hasMaskPlane, chunkyOutput) \
+	DEFINE_ILBM_ROW_DECODER(3, compressed, hasMaskPlane, chunkyOutput) \
+	DEFINE_ILBM_ROW_DECODER(4, compressed, hasMaskPlane, chunkyOutput) \
+	DEFINE_ILBM_ROW_DECODER(5, compressed, hasMaskPlane, chunkyOutput) \
+	DEFINE_ILBM_ROW_DECODER(6, compressed, hasMaskPlane, chunkyOutput) \
+	DEFINE_ILBM_ROW_DECODER(7, compressed, hasMaskPlane, chunkyOutput) \
+	DEFINE_ILBM_ROW_DECODER(8, compressed, hasMaskPlane, chunkyOutput)
 
+#define ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(compressed, hasMaskPlane, chunkyOutput) \
+	{ \
+		ILBM_ROW_DECODER_NAME(0, compressed, hasMaskPlane, chunkyOutput), \
+		ILBM_ROW_DECODER_NAME(1, compressed, hasMaskPlane, chunkyOutput), \
+		ILBM_ROW_DECODER_NAME(2, compressed, hasMaskPlane, chunkyOutput), \
+		ILBM_ROW_DECODER_NAME(3, compressed, hasMaskPlane, chunkyOutput), \
+		ILBM_ROW_DECODER_NAME(4, compressed, hasMaskPlane, chunkyOutput), \
+		ILBM_ROW_DECODER_NAME(5, compressed, hasMaskPlane, chunkyOutput), \
+		ILBM_ROW_DECODER_NAME(6, compressed, hasMaskPlane, chunkyOutput), \
+		ILBM_ROW_DECODER_NAME(7, compressed, hasMaskPlane, chunkyOutput), \
+		ILBM_ROW_DECODER_NAME(8, compressed, hasMaskPlane, chunkyOutput), \
+	}
+
+DEFINE_ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(0, 0, 0)
+DEFINE_ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(0, 0, 1)
+DEFINE_ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(0, 1, 0)
+DEFINE_ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(0, 1, 1)
+DEFINE_ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(1, 0, 0)
+DEFINE_ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(1, 0, 1)
+DEFINE_ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(1, 1, 0)
+DEFINE_ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(1, 1, 1)
+
+// Indexed by [compressed][hasMaskPlane][chunkyOutput][depth]
+static const BodyRowDecoder s_ilbmRowDecoders[2][2][2][MaxIlbmPlanes + 1] =
+{
+	{
+		{ ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(0, 0, 0), ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(0, 0, 1) },
+		{ ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(0, 1, 0), ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(0, 1, 1) },
+	},
+	{
+		{ ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(1, 0, 0), ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(1, 0, 1) },
+		{ ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(1, 1, 0), ILBM_ROW_DECODERS_FOR_ALL_DEPTHS(1, 1, 1) },
+	},
+};
+
+#define PBM_ROW_DECODER_NAME(compressed, chunkyOutput) decodePbmRow_##compressed##_##chunkyOutput
+
+#define DEFINE_PBM_ROW_DECODER(compressed, chunkyOutput) \
+	static const uint8_t* PBM_ROW_DECODER_NAME(compressed, chunkyOutput)(const LoadIffImageState* state, uint row, const uint8_t* sourcePtr, const uint8_t* sourcePtrEnd, uint8_t* rowBuffer) \
+	{ \
+		return decodePbmRow(state, row, sourcePtr, sourcePtrEnd, rowBuffer, compressed, chunkyOutput); \
+	}
+
+DEFINE_PBM_ROW_DECODER(0, 0)
+DEFINE_PBM_ROW_DECODER(0, 1)
+DEFINE_PBM_ROW_DECODER(1, 0)
+DEFINE_PBM_ROW_DECODER(1, 1)
+
+// Indexed by [compressed][chunkyOutput]
+static const BodyRowDecoder s_pbmRowDecoders[2][2] =
+{
+	{ PBM_ROW_DECODER_NAME(0, 0), PBM_ROW_DECODER_NAME(0, 1) },
+	{ PBM_ROW_DECODER_NAME(1, 0), PBM_ROW_DECODER_NAME(1, 1) },
+};
+
+// Picks the row decoder for this image once, after validateBodyFormat()
+static BodyRowDecoder selectBodyRowDecoder(const LoadIffImageState* state)
+{
+	uint compressed = (state->compression == cmpByteRun1) ? 1 : 0;
+	uint chunkyOutput = state->chunkyOutput ? 1 : 0;
+
+	if (state->pixelFormat == PixelFormat_Pbm)
+		return s_pbmRowDecoders[compressed][chunkyOutput];
+	else
+		return s_ilbmRowDecoders[compressed][state->hasMaskPlane ? 1 : 0][chunkyOutput][state->ilbm->depth];
+}
+
+// Finds where each row starts within the BODY, without decoding it; rowOffsets gets height + 1 entries
+static bool prescanBodyRows(const LoadIffImageState* state, const uint8_t* source, uint size, uint32_t* rowOffsets)
+{
+	Ilbm* ilbm = state->ilbm;
+	uint rowParts = (state->pixelFormat == PixelFormat_Pbm) ? 1 : ilbm->depth + (state->hasMaskPlane ? 1 : 0);
+	uint rowPartBytes = (state->pixelFormat == PixelFormat_Pbm) ? ilbm->width : ilbm->bytesPerRow;
+	uint32_t offset = 0;
+
+	for (uint row = 0; row < ilbm->height; ++row)
+	{
+		rowOffsets[row] = offset;
+
+		if (state->compression == cmpNone)
+		{
+			offset += rowParts * rowPartBytes;
+			if (offset > size)
+			{
+				reportError(state, "Error during BODY decoding (source buffer overrun)");
+				return false;
+			}
+		}
+		else
+			for (uint rowPart = 0; rowPart < rowParts; ++rowPart)
+			{
+				const uint8_t* nextRowPart = skipByteRun1(rowPartBytes, source + offset, source + size);
+				if (!nextRowPart)
+				{
+					reportError(state, "Error during BODY decoding (source buffer overrun)");
+					return false;
 				}
-				
-				break;
+				offset = nextRowPart - source;
 			}
-			default:
+	}
+
+	rowOffsets[ilbm->height] = offset;
+
+	if (offset != size)
+	{
+		reportError(state, "Error during BODY decoding (source buffer underrun/overrun)");
+		return false;
+	}
+
+	return true;
+}
+
+typedef struct
+{
+	const LoadIffImageState* state;
+	BodyRowDecoder decodeRow;
+	const uint8_t* source;
+	const uint32_t* rowOffsets;
+	uint firstRow;
+	uint endRow;
+	uint8_t* rowBuffer;
+} BodyDecodeBand;
+
+static void decodeBodyBand(void* band_)
+{
+	BodyDecodeBand* band = (BodyDecodeBand*) band_;
+
+	// The prescan has checked every row against the same rules, so decoding cannot fail here
+	for (uint row = band->firstRow; row < band->endRow; ++row)
+		band->decodeRow(band->state, row, band->source + band->rowOffsets[row], band->source + band->rowOffsets[row + 1], band->rowBuffer);
+}
+
+static bool decodeBodyParallel(LoadIffImageState* state, const uint8_t* source, uint size)
+{
+	Ilbm* ilbm = state->ilbm;
+	uint numBands = state->numDecodeThreads;
+	if (numBands > ilbm->height)
+		numBands = ilbm->height;
+
+	uint rowBufferBytes = getRowBufferBytes(state);
+	uint rowOffsetsBytes = (ilbm->height + 1) * sizeof(uint32_t);
+	uint bandsBytes = numBands * (sizeof(BodyDecodeBand) + sizeof(Thread*));
+	uint rowBuffersBytes = numBands * rowBufferBytes;
+	uint bytesToAllocate = rowOffsetsBytes + bandsBytes + rowBuffersBytes;
+
+	uint8_t* scratch = allocateMemory(state->allocator, bytesToAllocate);
+	if (!scratch)
+	{
+		char buf[1024];
+		sprintf(buf, "Unable to allocate %u bytes", bytesToAllocate);
+		reportError(state, buf);
+		return false;
+	}
+
+	BodyDecodeBand* bands = (BodyDecodeBand*) scratch;
+	Thread** threads = (Thread**) (bands + numBands);
+	uint32_t* rowOffsets = (uint32_t*) (threads + numBands);
+	uint8_t* rowBuffers = (uint8_t*) (rowOffsets + ilbm->height + 1);
+
+	if (!prescanBodyRows(state, source, size, rowOffsets))
+	{
+		releaseMemory(state->allocator, scratch);
+		return false;
+	}
+
+#ifdef DEBUG_IFF_IMAGE_PARSER
+	printf("DEBUG_IFF_IMAGE_PARSER: Decoding bitmap data in %u bands\n", numBands);
+#endif
+
+	if (rowBuffersBytes)
+		memset(rowBuffers, 0, rowBuffersBytes);
+
+	for (uint bandIndex = 0; bandIndex < numBands; ++bandIndex)
+	{
+		BodyDecodeBand* band = &bands[bandIndex];
+		band->state = state;
+		band->decodeRow = selectBodyRowDecoder(state);
+		band->source = source;
+		band->rowOffsets = rowOffsets;
+		band->firstRow = (ilbm->height * bandIndex) / numBands;
+		band->endRow = (ilbm->height * (bandIndex + 1)) / numBands;
+		band->rowBuffer = rowBuffersBytes ? rowBuffers + bandIndex * rowBufferBytes : 0;
+	}
+
+	// The first band is decoded on the calling thread
+	for (uint bandIndex = 1; bandIndex < numBands; ++bandIndex)
+		threads[bandIndex] = startThread(decodeBodyBand, &bands[bandIndex]);
+
+	decodeBodyBand(&bands[0]);
+
+	for (uint bandIndex = 1; bandIndex < numBands; ++bandIndex)
+		joinThread(threads[bandIndex]);
+
+	releaseMemory(state->allocator, scratch);
+	return true;
+}
+
+// True when the previous load of this file decoded exactly the same pixels, in the same layout
+static bool canReusePreviousPixels(const LoadIffImageState* state)
+{
+	const Ilbm* previousIlbm = state->previousIlbm;
+	const Ilbm* ilbm = state->ilbm;
+
+	return previousIlbm
+		&& state->encounteredBMHD
+		&& !state->encounteredBODY
+		&& fingerprintsEqual(&previousIlbm->bmhdFingerprint, &ilbm->bmhdFingerprint)
+		&& fingerprintsEqual(&previousIlbm->bodyFingerprint, &ilbm->bodyFingerprint)
+		&& (state->chunkyOutput ? previousIlbm->chunky != 0 : (!ilbm->depth || previousIlbm->planes[0].data != 0));
+}
+
+static bool handleBODY(void* state_, void* buffer, unsigned int size)
+{
+	LoadIffImageState* state = (LoadIffImageState*) state_;
+	Ilbm* ilbm = state->ilbm;
+
+	if (!state->encounteredBODY)
+	{
+		ilbm->bodyFingerprint.size = size;
+		ilbm->bodyFingerprint.hash = updateFingerprintHash(FingerprintHashBasis, buffer, size);
+
+		if (canReusePreviousPixels(state))
+		{
+#ifdef DEBUG_IFF_IMAGE_PARSER
+			printf("DEBUG_IFF_IMAGE_PARSER: BMHD and BODY unchanged, reusing previous bitmap\n");
+#endif
+			state->encounteredBODY = true;
+			state->reusePixels = true;
+			return true;
+		}
+	}
+
+	bool skip;
+	if (!beginBODY(state, &skip))
+		return false;
+	if (skip)
+		return true;
+
+	if (!validateBodyFormat(state))
+		return false;
+
+	if (state->numDecodeThreads > 1 && ilbm->height > 1)
+	{
+		if (!decodeBodyParallel(state, (const uint8_t*) buffer, size))
+			return false;
+	}
+	else
+	{
+		BodyRowDecoder decodeRow = selectBodyRowDecoder(state);
+		const uint8_t* sourcePtr = (const uint8_t*) buffer;
+		const uint8_t* sourcePtrEnd = sourcePtr + size;
+		for (uint row = 0; row < ilbm->height; ++row)
+		{
+			if (!(sourcePtr = decodeRow(state, row, sourcePtr, sourcePtrEnd, state->rowBuffer)))
 			{
-				char buf[1024];
-				sprintf(buf, "Unsupported pixelFormat %d", (int) state->pixelFormat);
-				state->errorFunc(buf);
+				reportError(state, "Error during BODY decoding (source buffer overrun)");
 				return false;
 			}
 		}
 		
-		if (sourcePtr > sourcePtrEnd)
+		if (sourcePtr != sourcePtrEnd)
 		{
-			state->errorFunc("Error during BODY decoding (source buffer overrun)");
+			reportError(state, "Error during BODY decoding (source buffer underrun/overrun)");
 			return false;
 		}
 	}
-	
-	if (sourcePtr != sourcePtrEnd)
+
+#ifdef DEBUG_IFF_IMAGE_PARSER
+	printf("DEBUG_IFF_IMAGE_PARSER: Finished decoding bitmap data\n");
+#endif
+	return true;
+}
+
+static uint getBodyRowPartBytes(const LoadIffImageState* state)
+{
+	return (state->pixelFormat == PixelFormat_Pbm) ? state->ilbm->width : state->ilbm->bytesPerRow;
+}
+
+// Returns 0 for row parts which are decoded but not kept (the mask plane)
+static uint8_t* getBodyRowPartDest(const LoadIffImageState* state)
+{
+	const BodyStreamPosition* position = &state->bodyStream;
+	Ilbm* ilbm = state->ilbm;
+
+	if (state->pixelFormat == PixelFormat_Pbm)
+		return state->chunkyOutput ? ilbm->chunky + position->row * ilbm->chunkyPitch : state->rowBuffer;
+	else if (position->rowPart >= ilbm->depth)
+		return 0;
+	else if (state->chunkyOutput)
+		return state->rowBuffer + position->rowPart * ilbm->bytesPerRow;
+	else
+		return (uint8_t*) ilbm->planes[position->rowPart].data + position->row * ilbm->planeRowStride;
+}
+
+static void finishCompletedBodyRowParts(LoadIffImageState* state)
+{
+	BodyStreamPosition* position = &state->bodyStream;
+	Ilbm* ilbm = state->ilbm;
+	uint rowParts = (state->pixelFormat == PixelFormat_Pbm) ? 1 : ilbm->depth + (state->hasMaskPlane ? 1 : 0);
+
+	while (position->row < ilbm->height && position->rowPartBytesDecoded == getBodyRowPartBytes(state))
 	{
-		state->errorFunc("Error during BODY decoding (source buffer underrun/overrun)");
-		return false;
+		if (state->pixelFormat == PixelFormat_Pbm && !state->chunkyOutput)
+			convertPbmRowToPlanes(state, position->row, state->rowBuffer);
+
+		position->rowPartBytesDecoded = 0;
+		if (++position->rowPart == rowParts)
+		{
+			if (state->pixelFormat == PixelFormat_Ilbm && state->chunkyOutput)
+				convertIlbmRowToChunky(state, position->row, state->rowBuffer);
+
+			position->rowPart = 0;
+			position->row++;
+		}
 	}
+}
+
+static bool decodeBodyStream(LoadIffImageState* state, const uint8_t* sourcePtr, uint size)
+{
+	BodyStreamPosition* position = &state->bodyStream;
+	const uint8_t* sourcePtrEnd = sourcePtr + size;
+
+	while (sourcePtr != sourcePtrEnd)
+	{
+		if (position->row == state->ilbm->height)
+		{
+			reportError(state, "Error during BODY decoding (source buffer overrun)");
+			return false;
+		}
+
+		uint8_t* destPtr = getBodyRowPartDest(state);
+		uint destBytesLeft = getBodyRowPartBytes(state) - position->rowPartBytesDecoded;
+		uint sourceBytesLeft = sourcePtrEnd - sourcePtr;
+
+		if (state->compression == cmpNone)
+		{
+			uint bytes = (destBytesLeft < sourceBytesLeft) ? destBytesLeft : sourceBytesLeft;
+			if (destPtr)
+				memcpy(destPtr + position->rowPartBytesDecoded, sourcePtr, bytes);
+			sourcePtr += bytes;
+			position->rowPartBytesDecoded += bytes;
+		}
+		else
+		{
+			switch (position->rleState)
+			{
+				case RleStreamState_Count:
+				{
+					int8_t count = *sourcePtr++;
+					if (count == -128)
+						break;
+
+					position->runBytesLeft = (count >= 0) ? (count + 1) : (-count + 1);
+					position->rleState = (count >= 0) ? RleStreamState_Literal : RleStreamState_RepeatValue;
+
+					if (position->runBytesLeft > destBytesLeft)
+					{
+						reportError(state, "Error during BODY decoding (run crosses row boundary)");
+						return false;
+					}
+					break;
+				}
+				case RleStreamState_Literal:
+				{
+					uint bytes = (position->runBytesLeft < sourceBytesLeft) ? position->runBytesLeft : sourceBytesLeft;
+					if (destPtr)
+						memcpy(destPtr + position->rowPartBytesDecoded, sourcePtr, bytes);
+					sourcePtr += bytes;
+					position->rowPartBytesDecoded += bytes;
+					position->runBytesLeft -= bytes;
+					if (!position->runBytesLeft)
+						position->rleState = RleStreamState_Count;
+					break;
+				}
+				case RleStreamState_RepeatValue:
+				{
+					uint8_t value = *sourcePtr++;
+					if (destPtr)
+						memset(destPtr + position->rowPartBytesDecoded, value, position->runBytesLeft);
+					position->rowPartBytesDecoded += position->runBytesLeft;
+					position->rleState = RleStreamState_Count;
+					break;
+				}
+			}
+		}
+
+		finishCompletedBodyRowParts(state);
+	}
+
+	return true;
+}
+
+static bool handleBODYStream(void* state_, void* buffer, unsigned int size, uint32_t chunkOffset, uint32_t chunkSize)
+{
+	LoadIffImageState* state = (LoadIffImageState*) state_;
+	BodyStreamPosition* position = &state->bodyStream;
+
+	if (!chunkOffset)
+	{
+		if (!beginBODY(state, &position->skip))
+			return false;
+		if (position->skip)
+			return true;
+
+		if (!validateBodyFormat(state))
+			return false;
+
+		position->row = 0;
+		position->rowPart = 0;
+		position->rowPartBytesDecoded = 0;
+		position->rleState = RleStreamState_Count;
+		finishCompletedBodyRowParts(state);
+
+		state->ilbm->bodyFingerprint.size = chunkSize;
+		state->ilbm->bodyFingerprint.hash = FingerprintHashBasis;
+	}
+
+	if (position->skip)
+		return true;
+
+	state->ilbm->bodyFingerprint.hash = updateFingerprintHash(state->ilbm->bodyFingerprint.hash, buffer, size);
+
+	if (!decodeBodyStream(state, (const uint8_t*) buffer, size))
+		return false;
+
+	if (chunkOffset + size == chunkSize)
+	{
+		if (position->row != state->ilbm->height || position->rleState != RleStreamState_Count)
+		{
+			reportError(state, "Error during BODY decoding (source buffer underrun/overrun)");
+			return false;
+		}
 
 #ifdef DEBUG_IFF_IMAGE_PARSER
-	printf("DEBUG_IFF_IMAGE_PARSER: Finished decoding bitmap data\n");
+		printf("DEBUG_IFF_IMAGE_PARSER: Finished decoding streamed bitmap data\n");
 #endif
+	}
+
 	return true;
 }
 
 static void cleanup(LoadIffImageState* state)
 {
+	releaseMemory(state->allocator, state->rowBuffer);
+
 	if (state->ilbm)
 		freeIlbm(state->ilbm);
-		
-	if (state->pbmRowBuffer)
-		free(state->pbmRowBuffer);
 }
 
-Ilbm* loadIffImage(const char* fileName, IffErrorFunc errorFunc)
+// Moves the pixels of the previous image over to the new one, which has the same BMHD. Pixels
+//  from another allocator are copied instead, as that allocator may be reset once the previous
+//  image is freed.
+static bool takeOverPreviousPixels(LoadIffImageState* state, Ilbm* ilbm, Ilbm* previousIlbm)
+{
+	memcpy(ilbm->planes, previousIlbm->planes, sizeof ilbm->planes);
+	ilbm->planeRowStride = previousIlbm->planeRowStride;
+	ilbm->interleaved = previousIlbm->interleaved;
+	ilbm->chunky = previousIlbm->chunky;
+	ilbm->chunkyPitch = previousIlbm->chunkyPitch;
+	ilbm->externalPixels = previousIlbm->externalPixels;
+	ilbm->pixelsReused = true;
+
+	if (ilbm->externalPixels || ilbm->allocator == previousIlbm->allocator)
+	{
+		memset(previousIlbm->planes, 0, sizeof previousIlbm->planes);
+		previousIlbm->chunky = 0;
+		return true;
+	}
+
+	uint pixelBytes = ilbm->chunky ? ilbm->chunkyPitch * ilbm->height : ilbm->bytesPerRow * ilbm->height * ilbm->depth;
+	const uint8_t* previousPixels = ilbm->chunky ? ilbm->chunky : (const uint8_t*) ilbm->planes[0].data;
+	if (!pixelBytes)
+		return true;
+
+	uint8_t* pixels = allocateMemory(state->allocator, pixelBytes);
+	if (!pixels)
+	{
+		memset(ilbm->planes, 0, sizeof ilbm->planes);
+		ilbm->chunky = 0;
+
+		char buf[1024];
+		sprintf(buf, "Unable to allocate %u bytes", pixelBytes);
+		reportError(state, buf);
+		return false;
+	}
+	memcpy(pixels, previousPixels, pixelBytes);
+
+	if (ilbm->chunky)
+		ilbm->chunky = pixels;
+	else
+	{
+		for (uint planeIndex = 0; planeIndex < ilbm->depth; ++planeIndex)
+			ilbm->planes[planeIndex].data = (void*) (pixels + ((const uint8_t*) previousIlbm->planes[planeIndex].data - previousPixels));
+	}
+	return true;
+}
+
+static Ilbm* loadIffImageFromSource(const char* fileName, const void* data, size_t size, const LoadIffImageOptions* options, Ilbm* previousIlbm, IffErrorFunc errorFunc, void* errorContext)
 {
-	LoadIffImageState loadIffImageState = { 0 };
+	LoadIffImageState state = { 0 };
 
-	IffChunkHandler chunkHandlers[] = {
+	static const IffChunkHandler chunkHandlers[] = {
 		{ ID_ILBM, handleILBM },
 		{ ID_PBM,  handlePBM },
 		{ ID_BMHD, handleBMHD },
 		{ ID_CMAP, handleCMAP },
 		{ ID_CRNG, handleCRNG },
-		{ ID_BODY, handleBODY },
+		{ ID_BODY, handleBODY, handleBODYStream },
 		{ 0, 0 },
 	};
-	IffParseRules parseRules;
+	IffParseRules parseRules = { 0 };
 	parseRules.errorFunc = errorFunc;
+	parseRules.errorContext = errorContext;
 	parseRules.chunkHandlers = chunkHandlers;
-	parseRules.chunkHandlerState = &loadIffImageState;
+	parseRules.chunkHandlerState = &state;
+	parseRules.streamWindowSize = options ? options->streamWindowSize : 0;
+	parseRules.readBlockSize = options ? options->readBlockSize : 0;
+	parseRules.handlerLocation = &state.location;
+	if (options)
+	{
+		parseRules.chunkBeginFunc = options->chunkBeginFunc;
+		parseRules.chunkEndFunc = options->chunkEndFunc;
+		parseRules.chunkEventContext = options->chunkEventContext;
+	}
+
+	if (options && options->parallelDecode)
+		state.numDecodeThreads = options->numDecodeThreads ? options->numDecodeThreads : getNumHardwareThreads();
+
+	state.chunkyOutput = options ? options->chunkyOutput : false;
+	state.interleaved = options ? options->interleaved : false;
+	state.allocator = options ? options->allocator : 0;
+	state.destinationFunc = options ? options->destinationFunc : 0;
+	state.destinationContext = options ? options->destinationContext : 0;
+	state.previousIlbm = previousIlbm;
+	parseRules.allocator = state.allocator;
+
+	state.errorFunc = errorFunc;
+	state.errorContext = errorContext;
+	state.location.fileName = fileName;
+
+	if (!(state.ilbm = allocateMemory(state.allocator, sizeof(Ilbm))))
+	{
+		reportError(&state, "Unable to allocate image");
+		return 0;
+	}
+	memset(state.ilbm, 0, sizeof(Ilbm));
+	state.ilbm->allocator = state.allocator;
 
-	loadIffImageState.errorFunc = errorFunc;
-	loadIffImageState.ilbm = malloc(sizeof Ilbm);
-	memset(loadIffImageState.ilbm, 0, sizeof Ilbm);
+	bool parsed;
+	if (!fileName)
+		parsed = parseIffMemory(data, size, &parseRules);
+	else if (parseRules.streamWindowSize)
+		parsed = parseIff(fileName, &parseRules);
+	else
+		parsed = parseIffMapped(fileName, &parseRules);
 
-	if (!parseIff(fileName, &parseRules))
+	if (!parsed)
 	{
-		cleanup(&loadIffImageState);
+		cleanup(&state);
 		return 0;
 	}
 	else
 	{
-		Ilbm* ilbm = loadIffImageState.ilbm;
-		loadIffImageState.ilbm = 0;
-		cleanup(&loadIffImageState);
+		if (state.reusePixels && !takeOverPreviousPixels(&state, state.ilbm, previousIlbm))
+		{
+			cleanup(&state);
+			return 0;
+		}
+
+		Ilbm* ilbm = state.ilbm;
+		state.ilbm = 0;
+		cleanup(&state);
 		return ilbm;
 	}
 }
 
+Ilbm* loadIffImage(const char* fileName, IffErrorFunc errorFunc, void* errorContext)
+{
+	return loadIffImageFromSource(fileName, 0, 0, 0, 0, errorFunc, errorContext);
+}
+
+Ilbm* loadIffImageWithOptions(const char* fileName, const LoadIffImageOptions* options, IffErrorFunc errorFunc, void* errorContext)
+{
+	return loadIffImageFromSource(fileName, 0, 0, options, 0, errorFunc, errorContext);
+}
+
+Ilbm* loadIffImageFromMemory(const void* data, size_t size, IffErrorFunc errorFunc, void* errorContext)
+{
+	return loadIffImageFromSource(0, data, size, 0, 0, errorFunc, errorContext);
+}
+
+Ilbm* loadIffImageFromMemoryWithOptions(const void* data, size_t size, const LoadIffImageOptions* options, IffErrorFunc errorFunc, void* errorContext)
+{
+	return loadIffImageFromSource(0, data, size, options, 0, errorFunc, errorContext);
+}
+
+Ilbm* reloadIffImage(const char* fileName, Ilbm* previousIlbm, const Allocator* allocator, IffErrorFunc errorFunc, void* errorContext)
+{
+	LoadIffImageOptions options = { 0 };
+	options.chunkyOutput = (previousIlbm->chunky != 0);
+	options.interleaved = previousIlbm->interleaved;
+	options.allocator = allocator;
+	return loadIffImageFromSource(fileName, 0, 0, &options, previousIlbm, errorFunc, errorContext);
+}
+
 void freeIlbm(Ilbm* ilbm)
 {
-	if (ilbm->depth && ilbm->planes[0].data)
-		free(ilbm->planes[0].data);
-	free(ilbm);
+	if (!ilbm->externalPixels)
+	{
+		if (ilbm->depth)
+			releaseMemory(ilbm->allocator, ilbm->planes[0].data);
+		releaseMemory(ilbm->allocator, ilbm->chunky);
+	}
+	releaseMemory(ilbm->allocator, ilbm);
+}
+
+void ilbmToChunky(const Ilbm* ilbm, uint8_t* dst, size_t pitch)
+{
+	if (ilbm->chunky)
+	{
+		for (uint row = 0; row < ilbm->height; ++row)
+			memcpy(dst + row * pitch, ilbm->chunky + row * ilbm->chunkyPitch, ilbm->width);
+		return;
+	}
+
+	PlanarToChunkyRowFunc planarToChunkyRow = selectPlanarToChunkyRowFunc(ilbm->depth);
+
+	for (uint row = 0; row < ilbm->height; ++row)
+	{
+		const uint8_t* planeRows[MaxIlbmPlanes];
+		for (uint plane = 0; plane < ilbm->depth; ++plane)
+			planeRows[plane] = (const uint8_t*) ilbm->planes[plane].data + row * ilbm->planeRowStride;
+
+		if (planarToChunkyRow)
+			planarToChunkyRow(planeRows, ilbm->width, dst + row * pitch);
+		else
+			memset(dst + row * pitch, 0, ilbm->width);
+	}
 }
@@ -3,7 +3,7 @@
 #define ILBM_H
 
 #include "Types.h"
-#include "ParseIff.h"
+#include "parseIff.h"
 
 typedef struct
 {
@@ -24,6 +24,13 @@ typedef struct
 	bool reverse;
 } IlbmColorRange;
 
+// Identifies the contents of a chunk well enough to tell whether it changed between two loads
+typedef struct
+{
+	uint32_t size;
+	uint32_t hash;
+} IlbmChunkFingerprint;
+
 enum { MaxIlbmColorRanges = 16 };
 enum { MaxIlbmPlanes = 8 };
 
@@ -35,11 +42,93 @@ typedef struct
 	IlbmPalette palette;
 	uint bytesPerRow;
 	IlbmPlane planes[MaxIlbmPlanes];
+	uint planeRowStride;	// From one row of a plane to the next; bytesPerRow, or depth * bytesPerRow when interleaved
+	bool interleaved;	// All planes of a row follow each other, and plane n starts n * bytesPerRow after plane 0
+	uint8_t* chunky;	// 8-bit pixels, chunkyPitch bytes per row; set instead of planes when loaded with chunkyOutput
+	uint chunkyPitch;
 	uint numColorRanges;
 	IlbmColorRange colorRanges[MaxIlbmColorRanges];
+
+	// What the pixels were decoded from; the BMHD fingerprint also covers the form type
+	IlbmChunkFingerprint bmhdFingerprint;
+	IlbmChunkFingerprint bodyFingerprint;
+	bool pixelsReused;	// set by reloadIffImage() when the pixels were taken over instead of decoded
+
+	const Allocator* allocator;	// What the image and its pixels were allocated from
+	bool externalPixels;	// Decoded into memory provided through LoadIffImageOptions.destinationFunc, which freeIlbm() leaves alone
 } Ilbm;
 
-Ilbm* loadIffImage(const char* fileName, IffErrorFunc errorFunc);
+// Memory for the loader to decode BODY into, instead of allocating its own: either one pointer per
+//  plane, with planeRowStride bytes from one row of a plane to the next, or 8-bit chunky pixels with
+//  chunkyPitch bytes per row. Chunky pixels are used when chunky is set, whatever chunkyOutput says.
+typedef struct
+{
+	void* planes[MaxIlbmPlanes];
+	uint planeRowStride;
+	uint8_t* chunky;
+	uint chunkyPitch;
+} IlbmDestination;
+
+// Called on the loading thread once BMHD has been read, with width, height and depth of ilbm set,
+//  right before BODY is decoded. Returns false to have the loader allocate the pixels itself.
+typedef bool (*IlbmDestinationFunc)(void* context, const Ilbm* ilbm, IlbmDestination* destination);
+
+typedef struct
+{
+	// When nonzero, the file is read in windows of this many bytes and BODY is decoded
+	//  as it streams past, instead of the whole file being held in memory at once
+	uint streamWindowSize;
+
+	// Size of the two blocks which a streamed file is read ahead in; 0 means DefaultReadAheadBlockSize
+	uint readBlockSize;
+
+	// Decode BODY in bands of rows on several threads; the result is identical to that
+	//  of the serial decoder. numDecodeThreads = 0 means one thread per hardware core.
+	//  Only used when BODY is not streamed.
+	bool parallelDecode;
+	uint numDecodeThreads;
+
+	// Produce 8-bit chunky pixels in Ilbm.chunky instead of bitplanes. PBM rows are then
+	//  decoded straight into place without ever going through planar form.
+	bool chunkyOutput;
+
+	// Store the planes interleaved, the way Amiga interleaved bitmaps are, so that the whole image
+	//  can be moved to such a bitmap in one go
+	bool interleaved;
+
+	// All memory of the load, the returned image included, comes from here; 0 means the C heap.
+	//  The allocator must outlive the image.
+	const Allocator* allocator;
+
+	// Decode BODY straight into memory which the caller provides, such as a screen bitmap, rather
+	//  than into memory of the image's own. The memory is written to even when the load later fails.
+	IlbmDestinationFunc destinationFunc;
+	void* destinationContext;
+
+	// Passed on to IffParseRules, to see where the time of a load goes; see IffParseStats.h
+	IffChunkBeginFunc chunkBeginFunc;
+	IffChunkEndFunc chunkEndFunc;
+	void* chunkEventContext;
+} LoadIffImageOptions;
+
+// The loaders keep all their state per call, so any number of images may be loaded at the same
+//  time on different threads. errorFunc is called with errorContext on the loading thread, and
+//  with the file offset of the chunk in which the problem was found.
+Ilbm* loadIffImage(const char* fileName, IffErrorFunc errorFunc, void* errorContext);
+Ilbm* loadIffImageWithOptions(const char* fileName, const LoadIffImageOptions* options, IffErrorFunc errorFunc, void* errorContext);
+Ilbm* loadIffImageFromMemory(const void* data, size_t size, IffErrorFunc errorFunc, void* errorContext);
+Ilbm* loadIffImageFromMemoryWithOptions(const void* data, size_t size, const LoadIffImageOptions* options, IffErrorFunc errorFunc, void* errorContext);
 void freeIlbm(Ilbm* ilbm);
 
+// Loads fileName again after it was loaded as previousIlbm. When the fingerprints show that
+//  neither BMHD nor BODY changed, BODY is not decoded. The new image then takes over the pixels
+//  of previousIlbm and has pixelsReused set, so only palette and color ranges are new.
+// The pixels are only moved once the file has parsed successfully, so previousIlbm stays intact
+//  on failure; the caller frees previousIlbm either way. The new image is allocated from
+//  allocator; when that is not the allocator of previousIlbm, taken over pixels are copied.
+Ilbm* reloadIffImage(const char* fileName, Ilbm* previousIlbm, const Allocator* allocator, IffErrorFunc errorFunc, void* errorContext);
+
+// Writes the image as 8-bit pixels, one row every pitch bytes; works for both planar and chunky images
+void ilbmToChunky(const Ilbm* ilbm, uint8_t* dst, size_t pitch);
+
 #endif
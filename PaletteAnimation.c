@@ -0,0 +1,441 @@
+
+#include "PaletteAnimation.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define PALETTEANIMATION_SSE2
+#include <emmintrin.h>
+#endif
+
+typedef struct
+{
+	uint64_t frame;
+	uint rangeId;
+} RangeDeadline;
+
+typedef struct
+{
+	uint firstColor;
+	uint numColors;
+} ColorSpan;
+
+struct PaletteAnimation
+{
+	const Ilbm* ilbm;
+	uint32_t colors[256];
+	bool rangesOverlap;
+
+	// Each range's colors, written out twice and rotated down by one: entry i holds range color
+	//  (i - 1) mod n. Any rotation of the range, and the neighbours it blends with, are then
+	//  contiguous runs of the table.
+	uint32_t* rotatedRangeColors;
+	uint rotatedRangeStart[MaxIlbmColorRanges];
+
+	// animatePaletteChanges() keeps colors up to date for the last frame it was called with,
+	//  along with a min-heap of the frames at which each range will next change
+	bool changesValid;
+	bool changesBlend;
+	uint changesFrame;
+	RangeDeadline deadlines[MaxIlbmColorRanges];
+	uint numDeadlines;
+
+	// Baked palettes hold, per tick, only the colors which some range covers, span after span;
+	//  all other colors never change
+	uint32_t* bakedPalettes;
+	ColorSpan bakedSpans[MaxIlbmColorRanges];
+	uint numBakedSpans;
+	uint numBakedColors;
+	uint bakedPeriod;
+	uint bakedBaseFrame;
+	uint bakedFrameStep;
+	bool bakedBlend;
+};
+
+static void blendColors(const uint32_t* colors0, const uint32_t* colors1, uint color1Weight, uint numColors, uint32_t* dest)
+{
+	uint color0Weight = 0x100 - color1Weight;
+	uint colorId = 0;
+
+#ifdef PALETTEANIMATION_SSE2
+	// Same per-channel (c0 * w0 + c1 * w1) >> 8 as below, eight channels per 16-bit multiply
+	__m128i zero = _mm_setzero_si128();
+	__m128i weight0 = _mm_set1_epi16((short) color0Weight);
+	__m128i weight1 = _mm_set1_epi16((short) color1Weight);
+	__m128i rgbMask = _mm_set1_epi32(0x00ffffff);
+
+	for (; colorId + 4 <= numColors; colorId += 4)
+	{
+		__m128i rgb0 = _mm_loadu_si128((const __m128i*) (colors0 + colorId));
+		__m128i rgb1 = _mm_loadu_si128((const __m128i*) (colors1 + colorId));
+
+		__m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(rgb0, zero), weight0),
+			_mm_mullo_epi16(_mm_unpacklo_epi8(rgb1, zero), weight1));
+		__m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(rgb0, zero), weight0),
+			_mm_mullo_epi16(_mm_unpackhi_epi8(rgb1, zero), weight1));
+
+		__m128i rgb = _mm_packus_epi16(_mm_srli_epi16(low, 8), _mm_srli_epi16(high, 8));
+		_mm_storeu_si128((__m128i*) (dest + colorId), _mm_and_si128(rgb, rgbMask));
+	}
+#endif
+
+	for (; colorId < numColors; ++colorId)
+	{
+		uint32_t rgb0 = colors0[colorId];
+		uint32_t rgb1 = colors1[colorId];
+
+		uint32_t rb0 = (rgb0 & 0x00ff00ff);
+		uint32_t rb1 = (rgb1 & 0x00ff00ff);
+		uint32_t rb = (((rb0 * color0Weight) + (rb1 * color1Weight)) >> 8) & 0x00ff00ff;
+		
+		uint32_t g0 = (rgb0 & 0x0000ff00);
+		uint32_t g1 = (rgb1 & 0x0000ff00);
+		uint32_t g = (((g0 * color0Weight) + (g1 * color1Weight)) >> 8) & 0x0000ff00;
+		
+		dest[colorId] = rb | g;
+	}
+}
+
+static void computeRange(const PaletteAnimation* animation, uint rangeId, uint frame, bool blend, uint32_t* colors)
+{
+	const IlbmColorRange* range = &animation->ilbm->colorRanges[rangeId];
+	const uint32_t* rotatedColors = animation->rotatedRangeColors + animation->rotatedRangeStart[rangeId];
+	uint frameInt = (frame >> 16);
+	uint frameFrac = frame & 0xffff;
+	if (range->high < range->low)
+		return;
+
+	uint colorsInRange = range->high - range->low + 1;
+	uint scaledFrameInt = frameInt * (range->rate << 2);
+	uint scaledFrameFrac = (frameFrac * range->rate) >> 14;
+	uint scaledFrame = scaledFrameInt + scaledFrameFrac;
+	
+	uint offset = (scaledFrame >> 16) % colorsInRange;
+	if (!range->reverse)
+		offset = (colorsInRange - offset) % colorsInRange;
+	
+	// Range color (colorId + offset) mod n is rotatedColors[colorId + offset + 1], and the color
+	//  it blends towards, one step back, is rotatedColors[colorId + offset]
+	if (blend)
+		blendColors(rotatedColors + offset + 1, rotatedColors + offset, (scaledFrame >> 8) & 0xff,
+			colorsInRange, colors + range->low);
+	else
+		memcpy(colors + range->low, rotatedColors + offset + 1, colorsInRange * sizeof(uint32_t));
+}
+
+static void computePalette(const PaletteAnimation* animation, uint frame, bool blend, uint32_t* colors)
+{
+	const Ilbm* ilbm = animation->ilbm;
+
+	memcpy(colors, ilbm->palette.colors, ilbm->palette.numColors * sizeof(uint32_t));
+
+	for (uint rangeId = 0; rangeId < ilbm->numColorRanges; ++rangeId)
+		computeRange(animation, rangeId, frame, blend, colors);
+}
+
+PaletteAnimation* createPaletteAnimation(const Ilbm* ilbm)
+{
+	PaletteAnimation* animation = malloc(sizeof(PaletteAnimation));
+	if (!animation)
+		return 0;
+
+	memset(animation, 0, sizeof(PaletteAnimation));
+	animation->ilbm = ilbm;
+
+	uint numRotatedColors = 0;
+	for (uint rangeId = 0; rangeId < ilbm->numColorRanges; ++rangeId)
+	{
+		// The loader leaves these out; anything else would have a range wrap around the palette
+		if (ilbm->colorRanges[rangeId].high < ilbm->colorRanges[rangeId].low || ilbm->colorRanges[rangeId].high > 255)
+		{
+			free(animation);
+			return 0;
+		}
+
+		animation->rotatedRangeStart[rangeId] = numRotatedColors;
+		numRotatedColors += 2 * (ilbm->colorRanges[rangeId].high - ilbm->colorRanges[rangeId].low + 1);
+	}
+
+	if (numRotatedColors && !(animation->rotatedRangeColors = malloc(numRotatedColors * sizeof(uint32_t))))
+	{
+		free(animation);
+		return 0;
+	}
+
+	for (uint rangeId = 0; rangeId < ilbm->numColorRanges; ++rangeId)
+	{
+		const IlbmColorRange* range = &ilbm->colorRanges[rangeId];
+		uint colorsInRange = range->high - range->low + 1;
+		uint32_t* rotatedColors = animation->rotatedRangeColors + animation->rotatedRangeStart[rangeId];
+
+		for (uint i = 0; i < 2 * colorsInRange; ++i)
+			rotatedColors[i] = ilbm->palette.colors[range->low + (i + colorsInRange - 1) % colorsInRange];
+	}
+
+	for (uint rangeId = 0; rangeId < ilbm->numColorRanges; ++rangeId)
+		for (uint otherRangeId = rangeId + 1; otherRangeId < ilbm->numColorRanges; ++otherRangeId)
+			if (ilbm->colorRanges[rangeId].low <= ilbm->colorRanges[otherRangeId].high
+				&& ilbm->colorRanges[otherRangeId].low <= ilbm->colorRanges[rangeId].high)
+				animation->rangesOverlap = true;
+
+	return animation;
+}
+
+void freePaletteAnimation(PaletteAnimation* animation)
+{
+	if (animation->bakedPalettes)
+		free(animation->bakedPalettes);
+	if (animation->rotatedRangeColors)
+		free(animation->rotatedRangeColors);
+	free(animation);
+}
+
+const uint32_t* animatePalette(PaletteAnimation* animation, uint frame, bool blend)
+{
+	if (animation->bakedPalettes && blend == animation->bakedBlend)
+	{
+		// Frames that are not on the baked grid (the speed changed since baking) are computed as usual
+		uint framesSinceBase = frame - animation->bakedBaseFrame;
+		if (!(framesSinceBase % animation->bakedFrameStep))
+		{
+			uint tick = (framesSinceBase / animation->bakedFrameStep) % animation->bakedPeriod;
+			const uint32_t* bakedColors = animation->bakedPalettes + tick * animation->numBakedColors;
+
+			for (uint spanId = 0; spanId < animation->numBakedSpans; ++spanId)
+			{
+				const ColorSpan* span = &animation->bakedSpans[spanId];
+				memcpy(animation->colors + span->firstColor, bakedColors, span->numColors * sizeof(uint32_t));
+				bakedColors += span->numColors;
+			}
+
+			animation->changesValid = false;
+			return animation->colors;
+		}
+	}
+
+	computePalette(animation, frame, blend, animation->colors);
+	animation->changesValid = false;
+	return animation->colors;
+}
+
+// A range's colors depend on floor(frame * rate / 16384) >> 16 when stepping, and >> 8 when
+//  blending; returns the first frame after the given one at which that value changes
+static uint64_t getNextRangeChangeFrame(const IlbmColorRange* range, uint frame, bool blend)
+{
+	uint shift = 14 + (blend ? 8 : 16);
+	uint64_t position = ((uint64_t) frame * range->rate) >> shift;
+	return (((position + 1) << shift) + range->rate - 1) / range->rate;
+}
+
+static void pushRangeDeadline(PaletteAnimation* animation, uint rangeId, uint64_t frame)
+{
+	RangeDeadline* deadlines = animation->deadlines;
+	uint index = animation->numDeadlines++;
+
+	while (index)
+	{
+		uint parent = (index - 1) / 2;
+		if (deadlines[parent].frame <= frame)
+			break;
+		deadlines[index] = deadlines[parent];
+		index = parent;
+	}
+
+	deadlines[index].frame = frame;
+	deadlines[index].rangeId = rangeId;
+}
+
+static RangeDeadline popRangeDeadline(PaletteAnimation* animation)
+{
+	RangeDeadline* deadlines = animation->deadlines;
+	RangeDeadline first = deadlines[0];
+	RangeDeadline last = deadlines[--animation->numDeadlines];
+	uint count = animation->numDeadlines;
+	uint index = 0;
+
+	while (2 * index + 1 < count)
+	{
+		uint child = 2 * index + 1;
+		if (child + 1 < count && deadlines[child + 1].frame < deadlines[child].frame)
+			child++;
+		if (last.frame <= deadlines[child].frame)
+			break;
+		deadlines[index] = deadlines[child];
+		index = child;
+	}
+
+	if (count)
+		deadlines[index] = last;
+	return first;
+}
+
+const uint32_t* animatePaletteChanges(PaletteAnimation* animation, uint frame, bool blend)
+{
+	const Ilbm* ilbm = animation->ilbm;
+
+	if (!animation->changesValid || blend != animation->changesBlend || frame < animation->changesFrame)
+	{
+		// Start over; this also covers the frame counter wrapping around
+		computePalette(animation, frame, blend, animation->colors);
+
+		animation->numDeadlines = 0;
+		for (uint rangeId = 0; rangeId < ilbm->numColorRanges; ++rangeId)
+		{
+			const IlbmColorRange* range = &ilbm->colorRanges[rangeId];
+			if (range->rate && range->high > range->low)
+				pushRangeDeadline(animation, rangeId, getNextRangeChangeFrame(range, frame, blend));
+		}
+
+		animation->changesValid = true;
+		animation->changesBlend = blend;
+		animation->changesFrame = frame;
+		return animation->colors;
+	}
+
+	animation->changesFrame = frame;
+
+	if (!animation->numDeadlines || animation->deadlines[0].frame > frame)
+		return 0;
+
+	while (animation->numDeadlines && animation->deadlines[0].frame <= frame)
+	{
+		RangeDeadline deadline = popRangeDeadline(animation);
+		const IlbmColorRange* range = &ilbm->colorRanges[deadline.rangeId];
+
+		if (!animation->rangesOverlap)
+			computeRange(animation, deadline.rangeId, frame, blend, animation->colors);
+
+		pushRangeDeadline(animation, deadline.rangeId, getNextRangeChangeFrame(range, frame, blend));
+	}
+
+	// Later ranges take precedence where ranges overlap, so those are redone from scratch
+	if (animation->rangesOverlap)
+		computePalette(animation, frame, blend, animation->colors);
+
+	return animation->colors;
+}
+
+static uint64_t greatestCommonDivisor(uint64_t a, uint64_t b)
+{
+	while (b)
+	{
+		uint64_t remainder = a % b;
+		a = b;
+		b = remainder;
+	}
+	return a;
+}
+
+// Returns 0 if the result would exceed limit
+static uint64_t leastCommonMultiple(uint64_t a, uint64_t b, uint64_t limit)
+{
+	uint64_t factor = a / greatestCommonDivisor(a, b);
+	if (factor > limit / b)
+		return 0;
+	return factor * b;
+}
+
+uint getPaletteAnimationPeriod(const Ilbm* ilbm, uint frameStep, uint maxTicks)
+{
+	if (!frameStep)
+		return 0;
+
+	// Range positions are floor(frame * rate / 16384), so after 65536 * cycleFrames frames a range
+	//  of n colors is back where it started (blend weight included) when
+	//  cycleFrames * rate * 4 is a multiple of n * 65536.
+
+	uint64_t limit = (uint64_t) maxTicks * frameStep;
+	uint64_t periodFrames = 65536;
+
+	for (uint rangeId = 0; rangeId < ilbm->numColorRanges; ++rangeId)
+	{
+		const IlbmColorRange* range = &ilbm->colorRanges[rangeId];
+		uint64_t stepsPerFrame = (uint64_t) range->rate * 4;
+		if (!stepsPerFrame || range->high <= range->low)
+			continue;
+
+		uint64_t rangeSteps = (uint64_t) (range->high - range->low + 1) * 65536;
+
+		uint64_t rangeCycleFrames = rangeSteps / greatestCommonDivisor(rangeSteps, stepsPerFrame);
+		if (!(periodFrames = leastCommonMultiple(periodFrames, rangeCycleFrames * 65536, limit)))
+			return 0;
+	}
+
+	if (!(periodFrames = leastCommonMultiple(periodFrames, frameStep, limit)))
+		return 0;
+
+	return (uint) (periodFrames / frameStep);
+}
+
+// Finds the runs of colors which lie within at least one range
+static void findBakedSpans(PaletteAnimation* animation)
+{
+	const Ilbm* ilbm = animation->ilbm;
+	bool covered[256] = { false };
+
+	for (uint rangeId = 0; rangeId < ilbm->numColorRanges; ++rangeId)
+		for (uint colorId = ilbm->colorRanges[rangeId].low; colorId <= ilbm->colorRanges[rangeId].high && colorId < ilbm->palette.numColors; ++colorId)
+			covered[colorId] = true;
+
+	animation->numBakedSpans = 0;
+	animation->numBakedColors = 0;
+	for (uint colorId = 0; colorId < ilbm->palette.numColors; ++colorId)
+	{
+		if (!covered[colorId])
+			continue;
+
+		if (colorId && covered[colorId - 1])
+			animation->bakedSpans[animation->numBakedSpans - 1].numColors++;
+		else
+		{
+			animation->bakedSpans[animation->numBakedSpans].firstColor = colorId;
+			animation->bakedSpans[animation->numBakedSpans].numColors = 1;
+			animation->numBakedSpans++;
+		}
+		animation->numBakedColors++;
+	}
+}
+
+bool bakePaletteAnimation(PaletteAnimation* animation, uint baseFrame, uint frameStep, bool blend, uint maxBytes)
+{
+	const Ilbm* ilbm = animation->ilbm;
+
+	if (animation->bakedPalettes)
+	{
+		free(animation->bakedPalettes);
+		animation->bakedPalettes = 0;
+	}
+
+	findBakedSpans(animation);
+	uint bytesPerTick = animation->numBakedColors * sizeof(uint32_t);
+	if (!bytesPerTick)
+		return false;
+
+	uint period = getPaletteAnimationPeriod(ilbm, frameStep, maxBytes / bytesPerTick);
+	if (!period)
+		return false;
+
+	if (!(animation->bakedPalettes = malloc(period * bytesPerTick)))
+		return false;
+
+	uint32_t* bakedColors = animation->bakedPalettes;
+	for (uint tick = 0; tick < period; ++tick)
+	{
+		computePalette(animation, baseFrame + tick * frameStep, blend, animation->colors);
+
+		for (uint spanId = 0; spanId < animation->numBakedSpans; ++spanId)
+		{
+			const ColorSpan* span = &animation->bakedSpans[spanId];
+			memcpy(bakedColors, animation->colors + span->firstColor, span->numColors * sizeof(uint32_t));
+			bakedColors += span->numColors;
+		}
+	}
+	animation->changesValid = false;
+
+	animation->bakedPeriod = period;
+	animation->bakedBaseFrame = baseFrame;
+	animation->bakedFrameStep = frameStep;
+	animation->bakedBlend = blend;
+	return true;
+}
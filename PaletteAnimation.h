@@ -0,0 +1,36 @@
+
+#ifndef PALETTEANIMATION_H
+#define PALETTEANIMATION_H
+
+#include "Types.h"
+#include "Ilbm.h"
+
+// Computes the color-cycled palettes of an image. The animation position is a 16.16 fixed-point
+//  frame counter, where one whole frame is one DPaint tick at normal speed.
+
+typedef struct PaletteAnimation PaletteAnimation;
+
+enum { DefaultMaxBakedPaletteBytes = 256 * 1024 };
+
+PaletteAnimation* createPaletteAnimation(const Ilbm* ilbm);
+void freePaletteAnimation(PaletteAnimation* animation);
+
+// Returns ilbm->palette.numColors colors; the array stays valid until the next call
+const uint32_t* animatePalette(PaletteAnimation* animation, uint frame, bool blend);
+
+// Like animatePalette(), but returns 0 when the palette is the same as for the previous call.
+//  Each range is only recomputed on the frames where its position changes, so frames where no
+//  range moves cost next to nothing. Baked palettes are not used.
+const uint32_t* animatePaletteChanges(PaletteAnimation* animation, uint frame, bool blend);
+
+// Length in ticks of one full animation cycle, when the frame counter advances frameStep per tick.
+//  Returns 0 if the cycle is longer than maxTicks.
+uint getPaletteAnimationPeriod(const Ilbm* ilbm, uint frameStep, uint maxTicks);
+
+// Precomputes one full cycle of palettes for frames baseFrame + n * frameStep, after which
+//  animatePalette() copies those frames from the table over the static colors. Only colors within
+//  some range are stored per frame. Returns false, and leaves the animation computing every frame,
+//  if the cycle would need more than maxBytes, or if no range covers any color.
+bool bakePaletteAnimation(PaletteAnimation* animation, uint baseFrame, uint frameStep, bool blend, uint maxBytes);
+
+#endif
@@ -0,0 +1,120 @@
+
+#include "PaletteRepaint.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+	uint32_t start;
+	uint32_t length;
+} PixelRun;
+
+struct PaletteRepaint
+{
+	// The runs of color c are runs[firstRun[c]] .. runs[firstRun[c + 1] - 1]
+	uint firstRun[257];
+	uint numPixels[256];
+	PixelRun* runs;
+};
+
+PaletteRepaint* createPaletteRepaint(const uint8_t* pixels, uint numPixels)
+{
+	PaletteRepaint* repaint = malloc(sizeof(PaletteRepaint));
+	if (!repaint)
+		return 0;
+
+	memset(repaint, 0, sizeof(PaletteRepaint));
+
+	uint numRuns[256] = { 0 };
+	for (uint i = 0; i < numPixels; )
+	{
+		uint start = i;
+		uint8_t color = pixels[i];
+		while (++i < numPixels && pixels[i] == color)
+			;
+		numRuns[color]++;
+		repaint->numPixels[color] += i - start;
+	}
+
+	uint totalRuns = 0;
+	for (uint color = 0; color < 256; ++color)
+	{
+		repaint->firstRun[color] = totalRuns;
+		totalRuns += numRuns[color];
+	}
+	repaint->firstRun[256] = totalRuns;
+
+	if (!(repaint->runs = malloc((totalRuns + 1) * sizeof(PixelRun))))
+	{
+		free(repaint);
+		return 0;
+	}
+
+	uint nextRun[256];
+	memcpy(nextRun, repaint->firstRun, sizeof nextRun);
+
+	for (uint i = 0; i < numPixels; )
+	{
+		uint start = i;
+		uint8_t color = pixels[i];
+		while (++i < numPixels && pixels[i] == color)
+			;
+		PixelRun* run = &repaint->runs[nextRun[color]++];
+		run->start = start;
+		run->length = i - start;
+	}
+
+	return repaint;
+}
+
+void freePaletteRepaint(PaletteRepaint* repaint)
+{
+	free(repaint->runs);
+	free(repaint);
+}
+
+uint countPaletteRepaintPixels(const PaletteRepaint* repaint, uint firstColor, uint numColors)
+{
+	uint numPixels = 0;
+	for (uint color = firstColor; color < firstColor + numColors; ++color)
+		numPixels += repaint->numPixels[color];
+	return numPixels;
+}
+
+void repaintColors(const PaletteRepaint* repaint, uint firstColor, uint numColors, const uint32_t* palette, uint32_t* rgbPixels)
+{
+	for (uint color = firstColor; color < firstColor + numColors; ++color)
+	{
+		uint32_t rgb = palette[color];
+		const PixelRun* run = &repaint->runs[repaint->firstRun[color]];
+		const PixelRun* endRun = &repaint->runs[repaint->firstRun[color + 1]];
+
+		for (; run != endRun; ++run)
+		{
+			uint32_t* dest = rgbPixels + run->start;
+			for (uint i = 0; i < run->length; ++i)
+				dest[i] = rgb;
+		}
+	}
+}
+
+void repaintAllColors(const uint8_t* pixels, uint numPixels, const uint32_t* palette, uint32_t* rgbPixels)
+{
+	uint i = 0;
+
+	for (; i + 4 <= numPixels; i += 4)
+	{
+		uint32_t rgb0 = palette[pixels[i + 0]];
+		uint32_t rgb1 = palette[pixels[i + 1]];
+		uint32_t rgb2 = palette[pixels[i + 2]];
+		uint32_t rgb3 = palette[pixels[i + 3]];
+		rgbPixels[i + 0] = rgb0;
+		rgbPixels[i + 1] = rgb1;
+		rgbPixels[i + 2] = rgb2;
+		rgbPixels[i + 3] = rgb3;
+	}
+
+	for (; i < numPixels; ++i)
+		rgbPixels[i] = palette[pixels[i]];
+}
@@ -0,0 +1,24 @@
+#ifndef PALETTEREPAINT_H
+#define PALETTEREPAINT_H
+
+#include "Types.h"
+
+// Remembers where each color index occurs in an 8-bit indexed image, as runs of equal pixels
+//  grouped by index, so that a palette change only needs to rewrite the RGB pixels of the
+//  colors which actually changed.
+
+typedef struct PaletteRepaint PaletteRepaint;
+
+PaletteRepaint* createPaletteRepaint(const uint8_t* pixels, uint numPixels);
+void freePaletteRepaint(PaletteRepaint* repaint);
+
+// Number of pixels which use any of the colors firstColor .. firstColor + numColors - 1
+uint countPaletteRepaintPixels(const PaletteRepaint* repaint, uint firstColor, uint numColors);
+
+// Rewrites the 0x00RRGGBB pixels of the colors firstColor .. firstColor + numColors - 1
+void repaintColors(const PaletteRepaint* repaint, uint firstColor, uint numColors, const uint32_t* palette, uint32_t* rgbPixels);
+
+// Rewrites every pixel; cheaper than repaintColors() once most of the image is affected
+void repaintAllColors(const uint8_t* pixels, uint numPixels, const uint32_t* palette, uint32_t* rgbPixels);
+
+#endif
@@ -0,0 +1,155 @@
+
+#include "PlanarToChunky.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define PLANARTOCHUNKY_SSE2
+#include <emmintrin.h>
+#endif
+
+// Each entry spreads the bits of one plane byte over 8 bytes (leftmost pixel first), one bit
+//  per byte. Shifting the 64-bit word left by the plane number then moves every bit within
+//  its own byte, so the result is independent of the host byte order.
+
+#define EXPAND_BITS(b) { ((b) >> 7) & 1, ((b) >> 6) & 1, ((b) >> 5) & 1, ((b) >> 4) & 1, ((b) >> 3) & 1, ((b) >> 2) & 1, ((b) >> 1) & 1, (b) & 1 }
+#define EXPAND_BITS4(b) EXPAND_BITS(b), EXPAND_BITS(b + 1), EXPAND_BITS(b + 2), EXPAND_BITS(b + 3)
+#define EXPAND_BITS16(b) EXPAND_BITS4(b), EXPAND_BITS4(b + 4), EXPAND_BITS4(b + 8), EXPAND_BITS4(b + 12)
+#define EXPAND_BITS64(b) EXPAND_BITS16(b), EXPAND_BITS16(b + 16), EXPAND_BITS16(b + 32), EXPAND_BITS16(b + 48)
+
+static const uint8_t expandedBits[256][8] = {
+	EXPAND_BITS64(0), EXPAND_BITS64(64), EXPAND_BITS64(128), EXPAND_BITS64(192),
+};
+
+#undef EXPAND_BITS64
+#undef EXPAND_BITS16
+#undef EXPAND_BITS4
+#undef EXPAND_BITS
+
+static uint64_t loadExpandedBits(uint8_t planeByte)
+{
+	uint64_t bits;
+	memcpy(&bits, expandedBits[planeByte], sizeof bits);
+	return bits;
+}
+
+#define GATHER_PLANE(depth, plane, byteIndex) \
+	if (depth > plane) \
+		pixels |= loadExpandedBits(planeRows[plane][byteIndex]) << plane;
+
+#define GATHER_PIXELS(depth, byteIndex) \
+	pixels = 0; \
+	GATHER_PLANE(depth, 0, byteIndex); \
+	GATHER_PLANE(depth, 1, byteIndex); \
+	GATHER_PLANE(depth, 2, byteIndex); \
+	GATHER_PLANE(depth, 3, byteIndex); \
+	GATHER_PLANE(depth, 4, byteIndex); \
+	GATHER_PLANE(depth, 5, byteIndex); \
+	GATHER_PLANE(depth, 6, byteIndex); \
+	GATHER_PLANE(depth, 7, byteIndex);
+
+// Converts the pixels from 'x' onwards 8 at a time, with a partial store for the last group
+#define CONVERT_REMAINING_PIXELS(depth) \
+	for (; x < numPixels; x += 8) \
+	{ \
+		uint64_t pixels; \
+		GATHER_PIXELS(depth, x >> 3); \
+		uint bytes = numPixels - x; \
+		memcpy(chunky + x, &pixels, (bytes < 8) ? bytes : 8); \
+	}
+
+#define DEFINE_PLANARTOCHUNKY_ROW_SCALAR(depth) \
+static void planarToChunkyRowScalar##depth(const uint8_t* const* planeRows, uint numPixels, uint8_t* chunky) \
+{ \
+	uint x = 0; \
+	CONVERT_REMAINING_PIXELS(depth); \
+}
+
+DEFINE_PLANARTOCHUNKY_ROW_SCALAR(1)
+DEFINE_PLANARTOCHUNKY_ROW_SCALAR(2)
+DEFINE_PLANARTOCHUNKY_ROW_SCALAR(3)
+DEFINE_PLANARTOCHUNKY_ROW_SCALAR(4)
+DEFINE_PLANARTOCHUNKY_ROW_SCALAR(5)
+DEFINE_PLANARTOCHUNKY_ROW_SCALAR(6)
+DEFINE_PLANARTOCHUNKY_ROW_SCALAR(7)
+DEFINE_PLANARTOCHUNKY_ROW_SCALAR(8)
+
+#ifdef PLANARTOCHUNKY_SSE2
+
+// 16 pixels at a time: both bytes of a plane word are broadcast over 8 lanes each, and every
+//  lane tests its own bit with a compare against a per-lane bit mask
+
+#define SPREAD_PLANE(depth, plane) \
+	if (depth > plane) \
+	{ \
+		__m128i bytes = _mm_cvtsi32_si128(planeRows[plane][byteOffset] | (planeRows[plane][byteOffset + 1] << 8)); \
+		bytes = _mm_unpacklo_epi8(bytes, bytes); \
+		bytes = _mm_unpacklo_epi16(bytes, bytes); \
+		bytes = _mm_unpacklo_epi32(bytes, bytes); \
+		__m128i isSet = _mm_cmpeq_epi8(_mm_and_si128(bytes, bitMasks), bitMasks); \
+		pixels = _mm_or_si128(pixels, _mm_and_si128(isSet, _mm_set1_epi8(1 << plane))); \
+	}
+
+#define DEFINE_PLANARTOCHUNKY_ROW_SSE2(depth) \
+static void planarToChunkyRowSse2##depth(const uint8_t* const* planeRows, uint numPixels, uint8_t* chunky) \
+{ \
+	const __m128i bitMasks = _mm_set_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80, \
+		0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80); \
+	uint x = 0; \
+	for (; x + 16 <= numPixels; x += 16) \
+	{ \
+		uint byteOffset = x >> 3; \
+		__m128i pixels = _mm_setzero_si128(); \
+		SPREAD_PLANE(depth, 0); \
+		SPREAD_PLANE(depth, 1); \
+		SPREAD_PLANE(depth, 2); \
+		SPREAD_PLANE(depth, 3); \
+		SPREAD_PLANE(depth, 4); \
+		SPREAD_PLANE(depth, 5); \
+		SPREAD_PLANE(depth, 6); \
+		SPREAD_PLANE(depth, 7); \
+		_mm_storeu_si128((__m128i*) (chunky + x), pixels); \
+	} \
+	CONVERT_REMAINING_PIXELS(depth); \
+}
+
+DEFINE_PLANARTOCHUNKY_ROW_SSE2(1)
+DEFINE_PLANARTOCHUNKY_ROW_SSE2(2)
+DEFINE_PLANARTOCHUNKY_ROW_SSE2(3)
+DEFINE_PLANARTOCHUNKY_ROW_SSE2(4)
+DEFINE_PLANARTOCHUNKY_ROW_SSE2(5)
+DEFINE_PLANARTOCHUNKY_ROW_SSE2(6)
+DEFINE_PLANARTOCHUNKY_ROW_SSE2(7)
+DEFINE_PLANARTOCHUNKY_ROW_SSE2(8)
+
+#undef SPREAD_PLANE
+
+#endif
+
+#undef CONVERT_REMAINING_PIXELS
+#undef GATHER_PIXELS
+#undef GATHER_PLANE
+
+static const PlanarToChunkyRowFunc planarToChunkyRowScalarFuncs[] = {
+	planarToChunkyRowScalar1, planarToChunkyRowScalar2, planarToChunkyRowScalar3, planarToChunkyRowScalar4,
+	planarToChunkyRowScalar5, planarToChunkyRowScalar6, planarToChunkyRowScalar7, planarToChunkyRowScalar8,
+};
+
+#ifdef PLANARTOCHUNKY_SSE2
+static const PlanarToChunkyRowFunc planarToChunkyRowSse2Funcs[] = {
+	planarToChunkyRowSse21, planarToChunkyRowSse22, planarToChunkyRowSse23, planarToChunkyRowSse24,
+	planarToChunkyRowSse25, planarToChunkyRowSse26, planarToChunkyRowSse27, planarToChunkyRowSse28,
+};
+#endif
+
+PlanarToChunkyRowFunc selectPlanarToChunkyRowFunc(uint depth)
+{
+	if (depth < 1 || depth > 8)
+		return 0;
+
+#ifdef PLANARTOCHUNKY_SSE2
+	return planarToChunkyRowSse2Funcs[depth - 1];
+#endif
+
+	return planarToChunkyRowScalarFuncs[depth - 1];
+}
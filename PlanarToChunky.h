@@ -0,0 +1,14 @@
+
+#ifndef PLANARTOCHUNKY_H
+#define PLANARTOCHUNKY_H
+
+#include "Types.h"
+
+// Converts bitplane rows back into numPixels 8-bit chunky pixels. Exactly numPixels bytes
+//  are written; bits from planes at or above the depth are taken to be zero.
+typedef void (*PlanarToChunkyRowFunc)(const uint8_t* const* planeRows, uint numPixels, uint8_t* chunky);
+
+// Picks the fastest converter available on this machine, specialized for the given depth (1-8)
+PlanarToChunkyRowFunc selectPlanarToChunkyRowFunc(uint depth);
+
+#endif
@@ -0,0 +1,339 @@
+
+#include "ReadAhead.h"
+
+#include <string.h>
+
+#ifdef AMIGA
+#include <dos/dos.h>
+#include <dos/dosextens.h>
+#include <proto/dos.h>
+#include <proto/exec.h>
+#else
+#include <pthread.h>
+#include <stdio.h>
+#endif
+
+// The caller consumes blocks[current] while blocks[current ^ 1] is being read into
+struct ReadAhead
+{
+	const Allocator* allocator;
+	size_t blockSize;
+	uint8_t* blocks[2];
+	size_t blockBytes;	// Valid bytes in blocks[current]
+	size_t position;	// Within blocks[current]
+	uint current;
+	bool readPending;
+	bool endOfFile;	// No more reads are to be issued
+	bool failed;
+	uint8_t* pendingBuffer;
+	size_t pendingBytes;	// Result of the pending read, once it has completed
+#ifdef AMIGA
+	BPTR fileHandle;
+	struct MsgPort* replyPort;	// Only when the file's handler takes packets
+	struct StandardPacket packet;
+	bool packetSent;
+#else
+	FILE* fileHandle;
+	pthread_t thread;	// Reads one block each time it is signalled, for as long as the ReadAhead lives
+	pthread_mutex_t mutex;
+	pthread_cond_t condition;	// Signalled when a read is requested, when it completes, and on quit
+	bool threadRunning;	// Otherwise reads are made synchronously
+	bool readRequested;	// Cleared by the thread once the read is done
+	bool quit;
+	bool pendingFailed;
+#endif
+};
+
+#ifdef AMIGA
+
+static void issueRead(ReadAhead* readAhead, uint8_t* buffer)
+{
+	struct FileHandle* fileHandle = (struct FileHandle*) BADDR(readAhead->fileHandle);
+
+	readAhead->readPending = true;
+	readAhead->pendingBuffer = buffer;
+
+	// Handlers such as NIL: have no process to send packets to
+	if (!readAhead->replyPort || !fileHandle->fh_Type)
+	{
+		readAhead->packetSent = false;
+		readAhead->pendingBytes = (size_t) Read(readAhead->fileHandle, buffer, readAhead->blockSize);
+		return;
+	}
+
+	struct StandardPacket* packet = &readAhead->packet;
+	packet->sp_Msg.mn_Node.ln_Name = (char*) &packet->sp_Pkt;
+	packet->sp_Pkt.dp_Link = &packet->sp_Msg;
+	packet->sp_Pkt.dp_Port = readAhead->replyPort;
+	packet->sp_Pkt.dp_Type = ACTION_READ;
+	packet->sp_Pkt.dp_Arg1 = fileHandle->fh_Arg1;
+	packet->sp_Pkt.dp_Arg2 = (LONG) buffer;
+	packet->sp_Pkt.dp_Arg3 = (LONG) readAhead->blockSize;
+	PutMsg(fileHandle->fh_Type, &packet->sp_Msg);
+	readAhead->packetSent = true;
+}
+
+static bool completeRead(ReadAhead* readAhead)
+{
+	readAhead->readPending = false;
+
+	LONG result = (LONG) readAhead->pendingBytes;
+	if (readAhead->packetSent)
+	{
+		WaitPort(readAhead->replyPort);
+		GetMsg(readAhead->replyPort);
+		result = readAhead->packet.sp_Pkt.dp_Res1;
+	}
+
+	if (result < 0)
+		return false;
+
+	readAhead->pendingBytes = (size_t) result;
+	return true;
+}
+
+static bool openFile(ReadAhead* readAhead, const char* fileName)
+{
+	if (!(readAhead->fileHandle = Open((STRPTR) fileName, MODE_OLDFILE)))
+		return false;
+
+	readAhead->replyPort = CreateMsgPort();	// Without one, reads are made synchronously
+	return true;
+}
+
+static void closeFile(ReadAhead* readAhead)
+{
+	if (readAhead->fileHandle)
+		Close(readAhead->fileHandle);
+	if (readAhead->replyPort)
+		DeleteMsgPort(readAhead->replyPort);
+	readAhead->fileHandle = 0;
+	readAhead->replyPort = 0;
+}
+
+// Reads go to the file's handler, which is a process of its own already
+static void startReader(ReadAhead* readAhead)
+{
+}
+
+static void stopReader(ReadAhead* readAhead)
+{
+}
+
+#else
+
+static void readBlock(ReadAhead* readAhead)
+{
+	readAhead->pendingBytes = fread(readAhead->pendingBuffer, 1, readAhead->blockSize, readAhead->fileHandle);
+	readAhead->pendingFailed = ferror(readAhead->fileHandle) != 0;
+}
+
+static void* readerThread(void* readAhead_)
+{
+	ReadAhead* readAhead = (ReadAhead*) readAhead_;
+
+	pthread_mutex_lock(&readAhead->mutex);
+	for (;;)
+	{
+		while (!readAhead->readRequested && !readAhead->quit)
+			pthread_cond_wait(&readAhead->condition, &readAhead->mutex);
+		if (!readAhead->readRequested)
+			break;
+
+		pthread_mutex_unlock(&readAhead->mutex);
+		readBlock(readAhead);
+		pthread_mutex_lock(&readAhead->mutex);
+
+		readAhead->readRequested = false;
+		pthread_cond_broadcast(&readAhead->condition);
+	}
+	pthread_mutex_unlock(&readAhead->mutex);
+	return 0;
+}
+
+static void issueRead(ReadAhead* readAhead, uint8_t* buffer)
+{
+	readAhead->readPending = true;
+	readAhead->pendingBuffer = buffer;
+
+	if (!readAhead->threadRunning)
+	{
+		readBlock(readAhead);
+		return;
+	}
+
+	pthread_mutex_lock(&readAhead->mutex);
+	readAhead->readRequested = true;
+	pthread_cond_broadcast(&readAhead->condition);
+	pthread_mutex_unlock(&readAhead->mutex);
+}
+
+static bool completeRead(ReadAhead* readAhead)
+{
+	if (readAhead->threadRunning)
+	{
+		pthread_mutex_lock(&readAhead->mutex);
+		while (readAhead->readRequested)
+			pthread_cond_wait(&readAhead->condition, &readAhead->mutex);
+		pthread_mutex_unlock(&readAhead->mutex);
+	}
+	readAhead->readPending = false;
+
+	return !readAhead->pendingFailed;
+}
+
+static bool openFile(ReadAhead* readAhead, const char* fileName)
+{
+	return (readAhead->fileHandle = fopen(fileName, "rb")) != 0;
+}
+
+static void closeFile(ReadAhead* readAhead)
+{
+	if (readAhead->fileHandle)
+		fclose(readAhead->fileHandle);
+	readAhead->fileHandle = 0;
+}
+
+// When the thread cannot be started, blocks are read synchronously instead
+static void startReader(ReadAhead* readAhead)
+{
+	if (pthread_mutex_init(&readAhead->mutex, 0))
+		return;
+
+	if (!pthread_cond_init(&readAhead->condition, 0))
+	{
+		if (!pthread_create(&readAhead->thread, 0, readerThread, readAhead))
+		{
+			readAhead->threadRunning = true;
+			return;
+		}
+		pthread_cond_destroy(&readAhead->condition);
+	}
+	pthread_mutex_destroy(&readAhead->mutex);
+}
+
+static void stopReader(ReadAhead* readAhead)
+{
+	if (!readAhead->threadRunning)
+		return;
+
+	pthread_mutex_lock(&readAhead->mutex);
+	readAhead->quit = true;
+	pthread_cond_broadcast(&readAhead->condition);
+	pthread_mutex_unlock(&readAhead->mutex);
+
+	pthread_join(readAhead->thread, 0);
+	pthread_cond_destroy(&readAhead->condition);
+	pthread_mutex_destroy(&readAhead->mutex);
+	readAhead->threadRunning = false;
+}
+
+#endif
+
+ReadAhead* createReadAhead(size_t blockSize, const Allocator* allocator)
+{
+	ReadAhead* readAhead = (ReadAhead*) allocateMemory(allocator, sizeof(ReadAhead));
+	if (!readAhead)
+		return 0;
+
+	memset(readAhead, 0, sizeof *readAhead);
+	readAhead->allocator = allocator;
+	readAhead->blockSize = blockSize ? blockSize : DefaultReadAheadBlockSize;
+
+	if (!(readAhead->blocks[0] = (uint8_t*) allocateMemory(allocator, readAhead->blockSize))
+		|| !(readAhead->blocks[1] = (uint8_t*) allocateMemory(allocator, readAhead->blockSize)))
+	{
+		freeReadAhead(readAhead);
+		return 0;
+	}
+
+	startReader(readAhead);
+	return readAhead;
+}
+
+void freeReadAhead(ReadAhead* readAhead)
+{
+	if (!readAhead)
+		return;
+
+	// The read in flight writes into one of the blocks
+	if (readAhead->readPending)
+		completeRead(readAhead);
+	stopReader(readAhead);
+	closeFile(readAhead);
+
+	const Allocator* allocator = readAhead->allocator;
+	releaseMemory(allocator, readAhead->blocks[1]);
+	releaseMemory(allocator, readAhead->blocks[0]);
+	releaseMemory(allocator, readAhead);
+}
+
+bool openReadAhead(ReadAhead* readAhead, const char* fileName)
+{
+	if (!openFile(readAhead, fileName))
+		return false;
+
+	// Start out with an empty block in use, so that the first block is read into the other one
+	readAhead->current = 1;
+	readAhead->blockBytes = 0;
+	readAhead->position = 0;
+	issueRead(readAhead, readAhead->blocks[0]);
+	return true;
+}
+
+size_t getReadAheadAvailable(ReadAhead* readAhead)
+{
+	if (readAhead->position != readAhead->blockBytes)
+		return readAhead->blockBytes - readAhead->position;
+
+	if (!readAhead->readPending)
+		return 0;
+
+	if (!completeRead(readAhead))
+	{
+		readAhead->failed = true;
+		readAhead->endOfFile = true;
+	}
+	else if (readAhead->pendingBytes != readAhead->blockSize)
+		readAhead->endOfFile = true;
+
+	readAhead->current ^= 1;
+	readAhead->blockBytes = readAhead->failed ? 0 : readAhead->pendingBytes;
+	readAhead->position = 0;
+
+	// The block just used up is free to be read into while this one is consumed
+	if (!readAhead->endOfFile)
+		issueRead(readAhead, readAhead->blocks[readAhead->current ^ 1]);
+
+	return readAhead->blockBytes;
+}
+
+const void* borrowReadAhead(ReadAhead* readAhead, size_t bytes)
+{
+	if (getReadAheadAvailable(readAhead) < bytes)
+		return 0;
+
+	const void* data = readAhead->blocks[readAhead->current] + readAhead->position;
+	readAhead->position += bytes;
+	return data;
+}
+
+bool readReadAhead(ReadAhead* readAhead, void* buffer, size_t bytes)
+{
+	uint8_t* dest = (uint8_t*) buffer;
+
+	while (bytes)
+	{
+		size_t available = getReadAheadAvailable(readAhead);
+		if (!available)
+			return false;
+
+		size_t copyBytes = (bytes < available) ? bytes : available;
+		memcpy(dest, readAhead->blocks[readAhead->current] + readAhead->position, copyBytes);
+		readAhead->position += copyBytes;
+		dest += copyBytes;
+		bytes -= copyBytes;
+	}
+
+	return true;
+}
@@ -0,0 +1,38 @@
+
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include "Types.h"
+#include "Allocator.h"
+
+#include <stddef.h>
+
+// Reads a file front to back in large blocks through two buffers: while the caller works on the
+//  data of one block, the next is being read, on a reader thread which the ReadAhead keeps for
+//  its whole life, or on AmigaOS with an asynchronous DOS read packet.
+
+typedef struct ReadAhead ReadAhead;
+
+enum { DefaultReadAheadBlockSize = 64 * 1024 };
+
+// Allocates both buffers, and starts the reader thread; returns 0 on out-of-memory
+ReadAhead* createReadAhead(size_t blockSize, const Allocator* allocator);
+
+// Waits for any read in flight, stops the reader thread, and closes the file
+void freeReadAhead(ReadAhead* readAhead);
+
+// Opens the file and starts reading its first block. Returns false if it cannot be opened.
+bool openReadAhead(ReadAhead* readAhead, const char* fileName);
+
+// Number of bytes which borrowReadAhead() can hand out in one piece right now, waiting for the
+//  next block if the current one is used up; 0 at the end of the file or after a read error
+size_t getReadAheadAvailable(ReadAhead* readAhead);
+
+// Returns the next bytes from within the current block, and moves past them, if there are that
+//  many in it; otherwise returns 0 and moves nowhere. The bytes stay valid until the next call.
+const void* borrowReadAhead(ReadAhead* readAhead, size_t bytes);
+
+// Copies the next bytes, across blocks if need be; false if the file ends first or cannot be read
+bool readReadAhead(ReadAhead* readAhead, void* buffer, size_t bytes);
+
+#endif
@@ -9,11 +9,40 @@
 #include <proto/graphics.h>
 #include <proto/intuition.h>
 
+struct GfxBase* GfxBase = 0;
+struct IntuitionBase* IntuitionBase = 0;
+
 static struct MsgPort* IDCMPMsgPort = 0;
 static struct MsgPort* OSMsgPort = 0;
 static struct Screen* OSScreen = 0;
 static struct Window* OSWindow = 0;
 
+bool initScreenAndInput(void)
+{
+	GfxBase = (struct GfxBase*) OpenLibrary("graphics.library", 39);
+	IntuitionBase = (struct IntuitionBase*) OpenLibrary("intuition.library", 39);
+
+	if (!GfxBase || !IntuitionBase)
+	{
+		printf("Unable to open graphics.library and intuition.library v39\n");
+		shutdownScreenAndInput();
+		return false;
+	}
+
+	return true;
+}
+
+void shutdownScreenAndInput(void)
+{
+	if (IntuitionBase)
+		CloseLibrary((struct Library*) IntuitionBase);
+	if (GfxBase)
+		CloseLibrary((struct Library*) GfxBase);
+
+	IntuitionBase = 0;
+	GfxBase = 0;
+}
+
 bool openScreen(uint width, uint height, uint depth)
 {
 	if (!(IDCMPMsgPort = CreateMsgPort()))
@@ -39,6 +68,7 @@ bool openScreen(uint width, uint height, uint depth)
 		SA_Width, width,
 		SA_Height, height,
 		SA_Depth, depth,
+		SA_Interleaved, TRUE,
 		SA_Title, "SuperCycler",
 		SA_ShowTitle, FALSE,
 		SA_Quiet, TRUE,
@@ -126,19 +156,32 @@ void closeScreen(void)
 
 void setPalette(uint numColors, uint32_t* colors)
 {
-	static uint32_t palette[1 + 256 * 3 + 1];
+	PaletteSpan span = { 0, numColors };
+	setPaletteSpans(&span, 1, colors);
+}
 
-	palette[0] = (numColors << 16) | 0;
+void setPaletteSpans(const PaletteSpan* spans, uint numSpans, const uint32_t* colors)
+{
+	// LoadRGB32 takes any number of (count, first color) records, each followed by its colors
+	static uint32_t palette[256 * 3 + 256 + 1];
+	uint32_t* dest = palette;
 
-	for (uint i = 0; i < numColors; ++i)
+	for (uint spanIndex = 0; spanIndex < numSpans; ++spanIndex)
 	{
-		uint32_t color = colors[i];
-		palette[1 + i * 3 + 0] = ((color >> 16) & 0xff) * 0x01010101;
-		palette[1 + i * 3 + 1] = ((color >> 8) & 0xff) * 0x01010101;
-		palette[1 + i * 3 + 2] = (color & 0xff) * 0x01010101;
+		const PaletteSpan* span = &spans[spanIndex];
+
+		*dest++ = (span->numColors << 16) | span->firstColor;
+
+		for (uint i = span->firstColor; i < span->firstColor + span->numColors; ++i)
+		{
+			uint32_t color = colors[i];
+			*dest++ = ((color >> 16) & 0xff) * 0x01010101;
+			*dest++ = ((color >> 8) & 0xff) * 0x01010101;
+			*dest++ = (color & 0xff) * 0x01010101;
+		}
 	}
 		
-	palette[1 + numColors*3] = 0;
+	*dest = 0;
 
  	LoadRGB32(&OSScreen->ViewPort, (ULONG*) palette);
 }
@@ -168,6 +211,12 @@ InputEvent getInputEvent(void)
 					event = InputEvent_ToggleBlend;
 				else if (key == 'r' || key == 'R')
 					event = InputEvent_Reload;
+				else if (key == 'n' || key == 'N')
+					event = InputEvent_NextImage;
+				else if (key == 'p' || key == 'P')
+					event = InputEvent_PreviousImage;
+				else if (key == 'f' || key == 'F')
+					event = InputEvent_DumpFrameStats;
 				break;
 			}
 			case IDCMP_MOUSEBUTTONS:
@@ -191,13 +240,58 @@ InputEvent getInputEvent(void)
 	return event;
 }
 
+void waitVerticalBlank(void)
+{
+	WaitTOF();
+	//WaitBOVP(&OSScreen->ViewPort);
+}
+
 void copyImageToScreen(Ilbm* ilbm)
 {
+	struct BitMap* bitMap = OSScreen->RastPort.BitMap;
+
+	if (!ilbm->depth || ilbm->planes[0].data == bitMap->Planes[0])
+		return;
+
+	// When both sides lay out their planes the same way, rows need not be copied one by one;
+	//  interleaved on both sides, the whole image goes over in a single copy
+	bool sameLayout = (ilbm->planeRowStride == bitMap->BytesPerRow);
+	for (uint plane = 1; plane < ilbm->depth && sameLayout; ++plane)
+		if ((uint8_t*) ilbm->planes[plane].data - (uint8_t*) ilbm->planes[0].data != bitMap->Planes[plane] - bitMap->Planes[0])
+			sameLayout = false;
+
+	if (sameLayout && ilbm->interleaved)
+	{
+		memcpy(bitMap->Planes[0], ilbm->planes[0].data, ilbm->height * ilbm->planeRowStride);
+		return;
+	}
+
+	if (ilbm->planeRowStride == ilbm->bytesPerRow && bitMap->BytesPerRow == ilbm->bytesPerRow)
+	{
+		for (uint plane = 0; plane < ilbm->depth; ++plane)
+			memcpy(bitMap->Planes[plane], ilbm->planes[plane].data, ilbm->height * ilbm->bytesPerRow);
+		return;
+	}
+
 	for (uint plane = 0; plane < ilbm->depth; ++plane)
 		for (uint row = 0; row < ilbm->height; ++row)
 		{
-			void* source = (uint8_t*) ilbm->planes[plane].data + row * ilbm->bytesPerRow;
-			void* dest = OSScreen->RastPort.BitMap->Planes[plane] + row * OSScreen->RastPort.BitMap->BytesPerRow;
+			void* source = (uint8_t*) ilbm->planes[plane].data + row * ilbm->planeRowStride;
+			void* dest = bitMap->Planes[plane] + row * bitMap->BytesPerRow;
 			memcpy(dest, source, ilbm->bytesPerRow);
 		}
 }
+
+bool getScreenDestination(uint width, uint height, uint depth, IlbmDestination* destination)
+{
+	if (!OSScreen || width > OSScreen->Width || height > OSScreen->Height
+		|| depth != OSScreen->RastPort.BitMap->Depth)
+		return false;
+
+	struct BitMap* bitMap = OSScreen->RastPort.BitMap;
+	for (uint plane = 0; plane < depth; ++plane)
+		destination->planes[plane] = bitMap->Planes[plane];
+	destination->planeRowStride = bitMap->BytesPerRow;
+	destination->chunky = 0;
+	return true;
+}
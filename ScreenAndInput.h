@@ -21,15 +21,43 @@ typedef enum
 	InputEvent_Speed9,
 	InputEvent_ToggleBlend,
 	InputEvent_Reload,
+	InputEvent_NextImage,
+	InputEvent_PreviousImage,
+	InputEvent_DumpFrameStats,
 } InputEvent;
 
+// Brings up the display and input system; must succeed before any other call below
+bool initScreenAndInput(void);
+void shutdownScreenAndInput(void);
+
 bool openScreen(uint width, uint height, uint depth);
 void closeScreen(void);
 
+typedef struct
+{
+	uint firstColor;
+	uint numColors;
+} PaletteSpan;
+
 void setPalette(uint numColors, uint32_t* colors);
 
+// Loads only the given runs of palette entries, all in one go; colors is indexed by palette entry
+void setPaletteSpans(const PaletteSpan* spans, uint numSpans, const uint32_t* colors);
+
 InputEvent getInputEvent(void);
 
+// How many times per second waitVerticalBlank() returns. The headless backend does not wait at all,
+//  but its virtual vertical blanks stand for display time at this same rate: frame n is shown at
+//  n / VerticalBlanksPerSecond seconds, whatever the time on the wall clock.
+enum { VerticalBlanksPerSecond = 50 };
+
+void waitVerticalBlank(void);
+
+// Does nothing but bring the display up to date when the image was decoded straight into the screen
 void copyImageToScreen(Ilbm* ilbm);
 
+// Describes the bitmap of the open screen, for decoding an image of the given size straight into it.
+//  Returns false when no screen of that size is open.
+bool getScreenDestination(uint width, uint height, uint depth, IlbmDestination* destination);
+
 #endif
@@ -0,0 +1,287 @@
+
+#include "ScreenAndInputHeadless.h"
+#include "Ilbm.h"
+#include "PaletteRepaint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// A display without a display: the screen is an 8-bit indexed framebuffer in memory, which
+//  is expanded into a 32-bit RGB framebuffer whenever image or palette change; palette changes
+//  only rewrite the pixels of the colors that changed, unless those cover most of the screen. Vertical
+//  blanks are virtual and return immediately, and input comes from a script.
+//
+// The script is read from the SUPERCYCLER_SCRIPT environment variable, as a list of
+//  <frame>:<key> pairs, where key is one of 1-9, space, b, r, n, p, f, esc or lmb. Without a script
+//  the viewer exits after DefaultHeadlessExitFrame frames.
+
+enum { MaxScriptedInputEvents = 256 };
+enum { DefaultHeadlessExitFrame = 3000 };
+
+typedef struct
+{
+	uint frame;
+	InputEvent event;
+} ScriptedInputEvent;
+
+static uint8_t* s_framebuffer = 0;
+static uint32_t* s_rgbFramebuffer = 0;
+static uint s_width = 0;
+static uint s_height = 0;
+static uint32_t s_palette[256];
+static PaletteRepaint* s_paletteRepaint = 0;
+
+static uint s_frameCount = 0;
+static uint s_numPaletteUploads = 0;
+static struct timespec s_startTime;
+
+static ScriptedInputEvent s_scriptedInputEvents[MaxScriptedInputEvents];
+static uint s_numScriptedInputEvents = 0;
+static uint s_nextScriptedInputEvent = 0;
+
+bool queueHeadlessInputEvent(uint frame, InputEvent event)
+{
+	if (s_numScriptedInputEvents == MaxScriptedInputEvents)
+		return false;
+
+	// Keep the script sorted by frame; events for the same frame stay in the order given
+	uint index = s_numScriptedInputEvents++;
+	while (index > s_nextScriptedInputEvent && s_scriptedInputEvents[index - 1].frame > frame)
+	{
+		s_scriptedInputEvents[index] = s_scriptedInputEvents[index - 1];
+		index--;
+	}
+
+	s_scriptedInputEvents[index].frame = frame;
+	s_scriptedInputEvents[index].event = event;
+	return true;
+}
+
+static InputEvent parseScriptedKey(const char* key)
+{
+	if (key[0] >= '1' && key[0] <= '9' && !key[1])
+		return InputEvent_Speed1 + (key[0] - '1');
+	else if (!strcmp(key, "space"))
+		return InputEvent_TogglePause;
+	else if (!strcmp(key, "b") || !strcmp(key, "B"))
+		return InputEvent_ToggleBlend;
+	else if (!strcmp(key, "r") || !strcmp(key, "R"))
+		return InputEvent_Reload;
+	else if (!strcmp(key, "n") || !strcmp(key, "N"))
+		return InputEvent_NextImage;
+	else if (!strcmp(key, "p") || !strcmp(key, "P"))
+		return InputEvent_PreviousImage;
+	else if (!strcmp(key, "f") || !strcmp(key, "F"))
+		return InputEvent_DumpFrameStats;
+	else if (!strcmp(key, "esc") || !strcmp(key, "lmb"))
+		return InputEvent_Exit;
+	else
+		return InputEvent_None;
+}
+
+static bool parseInputScript(const char* script)
+{
+	while (*script)
+	{
+		uint frame;
+		char key[16];
+		int charsConsumed;
+
+		if (sscanf(script, " %u:%15[^ \t\n,]%n", &frame, key, &charsConsumed) != 2)
+		{
+			printf("Malformed input script near \"%s\"\n", script);
+			return false;
+		}
+
+		InputEvent event = parseScriptedKey(key);
+		if (event == InputEvent_None)
+		{
+			printf("Unknown key \"%s\" in input script\n", key);
+			return false;
+		}
+
+		if (!queueHeadlessInputEvent(frame, event))
+		{
+			printf("Input script has too many events\n");
+			return false;
+		}
+
+		script += charsConsumed;
+		while (*script == ' ' || *script == '\t' || *script == '\n' || *script == ',')
+			script++;
+	}
+
+	return true;
+}
+
+bool initScreenAndInput(void)
+{
+	s_frameCount = 0;
+	s_numPaletteUploads = 0;
+	s_numScriptedInputEvents = 0;
+	s_nextScriptedInputEvent = 0;
+
+	const char* script = getenv("SUPERCYCLER_SCRIPT");
+	if (script)
+	{
+		if (!parseInputScript(script))
+			return false;
+	}
+	else
+		queueHeadlessInputEvent(DefaultHeadlessExitFrame, InputEvent_Exit);
+
+	clock_gettime(CLOCK_MONOTONIC, &s_startTime);
+	return true;
+}
+
+void shutdownScreenAndInput(void)
+{
+	struct timespec endTime;
+	clock_gettime(CLOCK_MONOTONIC, &endTime);
+
+	double seconds = (endTime.tv_sec - s_startTime.tv_sec) + (endTime.tv_nsec - s_startTime.tv_nsec) * 1e-9;
+	if (s_frameCount && seconds > 0.0)
+		printf("Headless display: %u frames in %.3f s (%.0f frames/s), %u palette uploads\n", s_frameCount, seconds, s_frameCount / seconds, s_numPaletteUploads);
+}
+
+bool openScreen(uint width, uint height, uint depth)
+{
+	uint numPixels = width * height;
+
+	closeScreen();
+
+	if (!(s_framebuffer = malloc(numPixels + 1))
+		|| !(s_rgbFramebuffer = malloc((numPixels + 1) * sizeof(uint32_t))))
+	{
+		printf("Unable to allocate %ux%u framebuffer\n", width, height);
+		closeScreen();
+		return false;
+	}
+
+	memset(s_framebuffer, 0, numPixels);
+	memset(s_rgbFramebuffer, 0, numPixels * sizeof(uint32_t));
+	memset(s_palette, 0, sizeof s_palette);
+	s_width = width;
+	s_height = height;
+
+	return true;
+}
+
+void closeScreen(void)
+{
+	if (s_paletteRepaint)
+	{
+		freePaletteRepaint(s_paletteRepaint);
+		s_paletteRepaint = 0;
+	}
+
+	free(s_framebuffer);
+	free(s_rgbFramebuffer);
+	s_framebuffer = 0;
+	s_rgbFramebuffer = 0;
+	s_width = 0;
+	s_height = 0;
+}
+
+static void expandFramebuffer(void)
+{
+	repaintAllColors(s_framebuffer, s_width * s_height, s_palette, s_rgbFramebuffer);
+}
+
+void setPalette(uint numColors, uint32_t* colors)
+{
+	if (numColors > 256)
+		numColors = 256;
+
+	memcpy(s_palette, colors, numColors * sizeof(uint32_t));
+	s_numPaletteUploads++;
+
+	if (s_framebuffer)
+		expandFramebuffer();
+}
+
+void setPaletteSpans(const PaletteSpan* spans, uint numSpans, const uint32_t* colors)
+{
+	for (uint spanIndex = 0; spanIndex < numSpans; ++spanIndex)
+		memcpy(&s_palette[spans[spanIndex].firstColor], &colors[spans[spanIndex].firstColor], spans[spanIndex].numColors * sizeof(uint32_t));
+
+	if (!numSpans)
+		return;
+
+	s_numPaletteUploads++;
+
+	if (!s_framebuffer)
+		return;
+
+	uint numChangedPixels = s_width * s_height;
+	if (s_paletteRepaint)
+	{
+		numChangedPixels = 0;
+		for (uint spanIndex = 0; spanIndex < numSpans; ++spanIndex)
+			numChangedPixels += countPaletteRepaintPixels(s_paletteRepaint, spans[spanIndex].firstColor, spans[spanIndex].numColors);
+	}
+
+	// Writing runs scattered all over the screen is slower per pixel than one linear pass
+	if (numChangedPixels > s_width * s_height / 2)
+		expandFramebuffer();
+	else
+		for (uint spanIndex = 0; spanIndex < numSpans; ++spanIndex)
+			repaintColors(s_paletteRepaint, spans[spanIndex].firstColor, spans[spanIndex].numColors, s_palette, s_rgbFramebuffer);
+}
+
+InputEvent getInputEvent(void)
+{
+	if (s_nextScriptedInputEvent == s_numScriptedInputEvents
+		|| s_scriptedInputEvents[s_nextScriptedInputEvent].frame > s_frameCount)
+		return InputEvent_None;
+
+	return s_scriptedInputEvents[s_nextScriptedInputEvent++].event;
+}
+
+void waitVerticalBlank(void)
+{
+	s_frameCount++;
+}
+
+void copyImageToScreen(Ilbm* ilbm)
+{
+	if (!s_framebuffer || ilbm->width > s_width || ilbm->height > s_height)
+		return;
+
+	if (ilbm->chunky != s_framebuffer)
+		ilbmToChunky(ilbm, s_framebuffer, s_width);
+	expandFramebuffer();
+
+	// Without the index runs, palette changes fall back to expanding the whole screen
+	if (s_paletteRepaint)
+		freePaletteRepaint(s_paletteRepaint);
+	s_paletteRepaint = createPaletteRepaint(s_framebuffer, s_width * s_height);
+}
+
+bool getScreenDestination(uint width, uint height, uint depth, IlbmDestination* destination)
+{
+	if (!s_framebuffer || width > s_width || height > s_height)
+		return false;
+
+	// The framebuffer is chunky whatever the depth
+	destination->chunky = s_framebuffer;
+	destination->chunkyPitch = s_width;
+	return true;
+}
+
+const uint8_t* getHeadlessFramebuffer(void)
+{
+	return s_framebuffer;
+}
+
+const uint32_t* getHeadlessRgbFramebuffer(void)
+{
+	return s_rgbFramebuffer;
+}
+
+uint getHeadlessFrameCount(void)
+{
+	return s_frameCount;
+}
@@ -0,0 +1,23 @@
+
+#ifndef SCREENANDINPUTHEADLESS_H
+#define SCREENANDINPUTHEADLESS_H
+
+#include "ScreenAndInput.h"
+
+// Extra entry points of the headless backend, for tools and tests which want to look
+//  at what would have been displayed
+
+// 8-bit indexed pixels, screen width bytes per row
+const uint8_t* getHeadlessFramebuffer(void);
+
+// The indexed framebuffer expanded through the current palette as 0x00RRGGBB pixels
+const uint32_t* getHeadlessRgbFramebuffer(void);
+
+// Number of virtual vertical blanks since initScreenAndInput(); divided by VerticalBlanksPerSecond,
+//  the display time in seconds
+uint getHeadlessFrameCount(void);
+
+// Adds an event to the input script, to be delivered by getInputEvent() once the given frame is reached
+bool queueHeadlessInputEvent(uint frame, InputEvent event);
+
+#endif
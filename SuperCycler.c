@@ -1,37 +1,246 @@
 
+#include "FileList.h"
+#include "FileWatch.h"
+#include "FrameStats.h"
 #include "Ilbm.h"
+#include "PaletteAnimation.h"
 #include "ScreenAndInput.h"
+#include "Thread.h"
+#include "Timer.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-#include <proto/exec.h>
-#include <proto/graphics.h>
-#include <proto/intuition.h>
+void parseErrorCallback(void* context, const IffErrorLocation* location, const char* message)
+{
+	char where[512];
+	formatIffErrorLocation(where, sizeof where, location);
+	printf("%s (%s)\n", message, where);
+}
 
-struct GfxBase* GfxBase = 0;
-struct IntuitionBase* IntuitionBase = 0;
+// A watched file is reloaded once it has not been written to for this long, so that
+//  programs which save in several goes are not caught halfway through. Measured on the timer
+//  rather than in vertical blanks, which the headless backend runs through as fast as it can.
+enum { WatchedFileSettleMicroseconds = 250000 };
 
-void parseErrorCallback(const char* message)
+// In a slideshow the file after the one on screen is decoded on a background thread (on AmigaOS
+//  a process of lower priority) while the current image keeps cycling, and swapped in on a
+//  vertical blank
+typedef struct
 {
-	puts(message);
-}
+	const char* fileName;
+	uint fileIndex;
+	const Allocator* allocator;
+	Ilbm* ilbm;
+	Thread* thread;
+	bool active;
+	bool restartPending;	// The running preload is no longer wanted; nextFileIndex follows once it is finished
+	uint nextFileIndex;
+	char error[1024];	// The first load error, printed once the preload is finished
+} Preload;
 
-static char s_ilbmName[256] = "";
+static FileList s_fileList = { 0 };
+static uint s_currentFile = 0;
+static uint s_slideshowDelay = 0;
+static Preload s_preload = { 0 };
+
+// Slideshow images are preloaded into whichever of the two arenas does not hold the image on
+//  screen, so that stepping through images reuses the same memory instead of going to the heap
+static ArenaAllocator s_imageArenas[2];
+static bool s_watchFile = false;
+static FileWatch* s_fileWatch = 0;
 static Ilbm* s_ilbm = 0;
+static PaletteAnimation* s_paletteAnimation = 0;
+static bool s_bakePaletteAnimation = false;
 static uint s_screenWidth = 0;
 static uint s_screenHeight = 0;
 static uint s_screenDepth = 0;
 
+// Per-frame timings of the display loop, with -stats; also written to SUPERCYCLER_FRAME_STATS
+//  when that is set
+static bool s_collectFrameStats = false;
+static const char* s_frameStatsFileName = 0;
+static FrameStats* s_frameStats = 0;
+
+static uint32_t s_uploadedColors[256];
+static uint s_numUploadedColors = 0;
+
+// The preload thread leaves stdio to the display loop
+static void preloadErrorCallback(void* preload_, const IffErrorLocation* location, const char* message)
+{
+	Preload* preload = (Preload*) preload_;
+	if (preload->error[0])
+		return;
+
+	char where[512];
+	formatIffErrorLocation(where, sizeof where, location);
+	snprintf(preload->error, sizeof preload->error, "%s (%s)", message, where);
+}
+
+static void preloadImage(void* preload_)
+{
+	Preload* preload = (Preload*) preload_;
+	LoadIffImageOptions options = { 0 };
+	options.allocator = preload->allocator;
+	options.interleaved = true;	// Like the screen, so that it is copied over in one go
+	preload->ilbm = loadIffImageWithOptions(preload->fileName, &options, preloadErrorCallback, preload);
+}
+
+// The arena which the image on screen is not in
+static ArenaAllocator* getIdleArena(void)
+{
+	return &s_imageArenas[(s_ilbm && s_ilbm->allocator == &s_imageArenas[0].allocator) ? 1 : 0];
+}
+
+static void startPreload(uint fileIndex)
+{
+	ArenaAllocator* arena = getIdleArena();
+	resetArenaAllocator(arena);
+
+	s_preload.fileName = s_fileList.fileNames[fileIndex];
+	s_preload.fileIndex = fileIndex;
+	s_preload.allocator = &arena->allocator;
+	s_preload.ilbm = 0;
+	s_preload.error[0] = 0;
+	s_preload.active = true;
+	s_preload.restartPending = false;
+	s_preload.thread = startThread(preloadImage, &s_preload);
+}
+
+// Waits for the preload to finish, and hands over its image
+static Ilbm* finishPreload(void)
+{
+	if (!s_preload.active)
+		return 0;
+
+	joinThread(s_preload.thread);
+	s_preload.thread = 0;
+	s_preload.active = false;
+
+	if (s_preload.error[0])
+		printf("%s\n", s_preload.error);
+	return s_preload.ilbm;
+}
+
+// The file which is being preloaded, or will be once the running preload is finished
+static uint getPreloadTarget(void)
+{
+	return s_preload.restartPending ? s_preload.nextFileIndex : s_preload.fileIndex;
+}
+
+// Starts the preload which restartPreload() queued, once the running one is finished
+static void updatePreload(void)
+{
+	if (!s_preload.restartPending || !isThreadFinished(s_preload.thread))
+		return;
+
+	Ilbm* preloadedIlbm = finishPreload();
+	if (preloadedIlbm)
+		freeIlbm(preloadedIlbm);
+	startPreload(s_preload.nextFileIndex);
+}
+
+// Makes sure the preload is for the given file, throwing away any other image. A preload of
+//  another file is never waited for; it is left to finish, and updatePreload() moves on from it.
+static void restartPreload(uint fileIndex)
+{
+	if (s_preload.active && s_preload.fileIndex == fileIndex)
+	{
+		s_preload.restartPending = false;
+		return;
+	}
+
+	if (s_preload.active && !isThreadFinished(s_preload.thread))
+	{
+		s_preload.restartPending = true;
+		s_preload.nextFileIndex = fileIndex;
+		return;
+	}
+
+	Ilbm* preloadedIlbm = finishPreload();
+	if (preloadedIlbm)
+		freeIlbm(preloadedIlbm);
+	startPreload(fileIndex);
+}
+
+static void reportFrameStats(void)
+{
+	printFrameStats(s_frameStats);
+	if (s_frameStatsFileName && !writeFrameStatsFile(s_frameStats, s_frameStatsFileName))
+		printf("Unable to write frame statistics to %s\n", s_frameStatsFileName);
+}
+
 void cleanup(void)
 {
+	stopFileWatch(s_fileWatch);
+	s_fileWatch = 0;
+
+	Ilbm* preloadedIlbm = finishPreload();
+	if (preloadedIlbm)
+		freeIlbm(preloadedIlbm);
+
+	if (s_paletteAnimation)
+	{
+		freePaletteAnimation(s_paletteAnimation);
+		s_paletteAnimation = 0;
+	}
+
 	if (s_ilbm)
 	{
 		freeIlbm(s_ilbm);
 		s_ilbm = 0;
 	}
 
+	freeArenaAllocator(&s_imageArenas[0]);
+	freeArenaAllocator(&s_imageArenas[1]);
+
 	closeScreen();
+	shutdownScreenAndInput();
+	freeFileList(&s_fileList);
+
+	if (s_frameStats)
+	{
+		reportFrameStats();
+		freeFrameStats(s_frameStats);
+		s_frameStats = 0;
+	}
+
+	shutdownTimer();
+}
+
+// Uploads only the runs of colors which differ from what the screen currently shows
+void uploadPalette(uint numColors, const uint32_t* colors)
+{
+	PaletteSpan spans[128];
+	uint numSpans = 0;
+	uint color = 0;
+
+	while (color < numColors)
+	{
+		if (color < s_numUploadedColors && colors[color] == s_uploadedColors[color])
+		{
+			color++;
+			continue;
+		}
+
+		uint firstColor = color;
+		while (color < numColors && (color >= s_numUploadedColors || colors[color] != s_uploadedColors[color]))
+			color++;
+
+		spans[numSpans].firstColor = firstColor;
+		spans[numSpans].numColors = color - firstColor;
+		numSpans++;
+	}
+
+	if (!numSpans)
+		return;
+
+	setPaletteSpans(spans, numSpans, colors);
+
+	memcpy(s_uploadedColors, colors, numColors * sizeof(uint32_t));
+	if (numColors > s_numUploadedColors)
+		s_numUploadedColors = numColors;
 }
 
 void setBlackPalette(void)
@@ -39,102 +248,139 @@ void setBlackPalette(void)
 	static uint32_t allBlackColors[256] = { 0 };
 
 	if (s_screenDepth)
-		setPalette(1 << s_screenDepth, allBlackColors);
+		uploadPalette(1 << s_screenDepth, allBlackColors);
 }
 	
 
-void animatePalette(Ilbm* ilbm, uint frame, bool blend)
+// Makes sure that a screen of the given size is open
+static bool prepareScreen(uint width, uint height, uint depth)
 {
-	static uint32_t colors[256];
-	uint frameInt = (frame >> 16);
-	uint frameFrac = frame & 0xffff;
+	if (width == s_screenWidth
+		&& height == s_screenHeight
+		&& depth == s_screenDepth)
+		return true;
 
-	memcpy(colors, ilbm->palette.colors, ilbm->palette.numColors * sizeof uint32_t);
-
-	for (uint rangeId = 0; rangeId < ilbm->numColorRanges; ++rangeId)
-	{
-		IlbmColorRange* range = &ilbm->colorRanges[rangeId];
-		uint colorsInRange = range->high - range->low + 1;
-		uint scaledFrameInt = frameInt * (range->rate << 2);
-		uint scaledFrameFrac = (frameFrac * range->rate) >> 14;
-		uint scaledFrame = scaledFrameInt + scaledFrameFrac;
-		
-		uint offset = (scaledFrame >> 16) % colorsInRange;
-		if (!range->reverse)
-			offset = (colorsInRange - offset) % colorsInRange;
-		
-		if (blend)
-		{
-			uint offsetFrac = (scaledFrame >> 8) & 0xff;
-			uint color1Weight = (scaledFrame >> 8) & 0xff;
-			uint color0Weight = 0x100 - color1Weight;
-			for (uint colorId = 0; colorId < colorsInRange; ++colorId)
-			{
-				uint color0 = (colorId + offset) % colorsInRange;
-				uint color1 = (color0 + colorsInRange - 1) % colorsInRange;
-
-				uint32_t rgb0 = ilbm->palette.colors[range->low + color0];
-				uint32_t rgb1 = ilbm->palette.colors[range->low + color1];
-
-				uint32_t rb0 = (rgb0 & 0x00ff00ff);
-				uint32_t rb1 = (rgb1 & 0x00ff00ff);
-				uint32_t rb = (((rb0 * color0Weight) + (rb1 * color1Weight)) >> 8) & 0x00ff00ff;
-				
-				uint32_t g0 = (rgb0 & 0x0000ff00);
-				uint32_t g1 = (rgb1 & 0x0000ff00);
-				uint32_t g = (((g0 * color0Weight) + (g1 * color1Weight)) >> 8) & 0x0000ff00;
-				
-				uint32_t rgb = rb | g;
-				colors[range->low + colorId] = rgb;
-			}
-		}
-		else
-			for (uint colorId = 0; colorId < colorsInRange; ++colorId)
-				colors[range->low + colorId] = ilbm->palette.colors[range->low + (colorId + offset) % colorsInRange];
-	}
+	closeScreen();
 	
-	setPalette(ilbm->palette.numColors, colors);
+	if (!openScreen(width, height, depth))
+		return false;
+
+	// Nothing is known about the palette of a freshly opened screen
+	s_numUploadedColors = 0;
+
+	s_screenWidth = width;
+	s_screenHeight = height;
+	s_screenDepth = depth;
+	return true;
 }
 
-bool displayImage(const char* fileName)
+// Takes over ilbm, and puts it on screen in place of the current image; when ilbm
+//  took over the pixels of the current image, only palette and ranges are applied
+bool showImage(Ilbm* ilbm)
 {
+	if (s_paletteAnimation)
+	{
+		freePaletteAnimation(s_paletteAnimation);
+		s_paletteAnimation = 0;
+	}
+
 	if (s_ilbm)
 	{
 		freeIlbm(s_ilbm);
 		s_ilbm = 0;
 	}
 	
-	Ilbm* ilbm = loadIffImage(fileName, parseErrorCallback);
+	s_ilbm = ilbm;
 
-	if (!ilbm)
+	if (!(s_paletteAnimation = createPaletteAnimation(ilbm)))
 		return false;
 
-	s_ilbm = ilbm;
+	if (ilbm->pixelsReused)
+	{
+		uploadPalette(ilbm->palette.numColors, ilbm->palette.colors);
+		return true;
+	}
 
 	setBlackPalette();
 	
-	if (ilbm->width != s_screenWidth
-		|| ilbm->height != s_screenHeight
-		|| ilbm->depth != s_screenDepth)
-	{
-		
-		closeScreen();
-		
-		if (!openScreen(ilbm->width, ilbm->height, ilbm->depth))
-			return false;
-
-		s_screenWidth = ilbm->width;
-		s_screenHeight = ilbm->height;
-		s_screenDepth = ilbm->depth;
-	}
+	if (!prepareScreen(ilbm->width, ilbm->height, ilbm->depth))
+		return false;
 		
 	copyImageToScreen(ilbm);
 	
-	setPalette(ilbm->palette.numColors, ilbm->palette.colors);
+	uploadPalette(ilbm->palette.numColors, ilbm->palette.colors);
+
+	return true;
+}
+
+// Has BODY decoded straight into the screen, which is blanked, and reopened if it does not fit the image
+static bool decodeIntoScreen(void* context, const Ilbm* ilbm, IlbmDestination* destination)
+{
+	setBlackPalette();
+
+	if (!prepareScreen(ilbm->width, ilbm->height, ilbm->depth))
+		return false;
+
+	return getScreenDestination(ilbm->width, ilbm->height, ilbm->depth, destination);
+}
+
+// Only for when no image is on screen yet; a failed load leaves the screen with whatever was decoded
+bool displayImage(const char* fileName)
+{
+	LoadIffImageOptions options = { 0 };
+	options.destinationFunc = decodeIntoScreen;
+
+	Ilbm* ilbm = loadIffImageWithOptions(fileName, &options, parseErrorCallback, 0);
+
+	if (!ilbm)
+		return false;
+
+	return showImage(ilbm);
+}
+
+// Loads the current image again; a failed reload, such as of a file caught halfway
+//  through being saved, leaves the current image on screen
+bool reloadImage(const char* fileName)
+{
+	// Freeing an image in an arena gives nothing back, so a slideshow image is reloaded into the
+	//  idle arena instead of its own, which the preload is then started over in
+	bool inArena = (s_ilbm->allocator == &s_imageArenas[0].allocator || s_ilbm->allocator == &s_imageArenas[1].allocator);
+	bool preloading = s_preload.active;
+	uint preloadFileIndex = getPreloadTarget();
+	const Allocator* allocator = s_ilbm->allocator;
+
+	if (inArena)
+	{
+		Ilbm* preloadedIlbm = finishPreload();
+		if (preloadedIlbm)
+			freeIlbm(preloadedIlbm);
+
+		ArenaAllocator* arena = getIdleArena();
+		resetArenaAllocator(arena);
+		allocator = &arena->allocator;
+	}
+
+	Ilbm* ilbm = reloadIffImage(fileName, s_ilbm, allocator, parseErrorCallback, 0);
+
+	if (ilbm && !showImage(ilbm))
+		return false;
 
+	if (inArena && preloading)
+		startPreload(preloadFileIndex);
 	return true;
 }
 
+// Moves the watch over to the file now on screen
+static void watchCurrentFile(void)
+{
+	if (!s_watchFile)
+		return;
+
+	stopFileWatch(s_fileWatch);
+	if (!(s_fileWatch = startFileWatch(s_fileList.fileNames[s_currentFile])))
+		printf("Unable to watch %s for changes\n", s_fileList.fileNames[s_currentFile]);
+}
+
 void displayLoop()
 {
 	static int frame = 0;
@@ -142,10 +388,22 @@ void displayLoop()
 	bool pause = false;
 	bool blend = false;
 	int speed = 1;
+	bool rebake = true;
+	bool changeImage = false;
+	uint changeDirection = 1;
+	uint framesUntilNextImage = s_slideshowDelay;
+	bool reloadPending = false;
+	TimerTicks lastFileChange = 0;
+	uint numFiles = s_fileList.numFiles;
+
+	if (numFiles > 1)
+		startPreload((s_currentFile + 1) % numFiles);
+
 	while (!exitFlag)
 	{
-		WaitTOF();
-		//WaitBOVP(&OSScreen->ViewPort);
+		waitVerticalBlank();
+		beginFrameStats(s_frameStats);
+
 		InputEvent event;
 		while ((event = getInputEvent()) != InputEvent_None)
 		{
@@ -154,19 +412,106 @@ void displayLoop()
 			else if (event == InputEvent_TogglePause)
 				pause = !pause;
 			else if (event == InputEvent_ToggleBlend)
+			{
 				blend = !blend;
+				rebake = true;
+			}
 			else if (event >= InputEvent_Speed1 && event <= InputEvent_Speed9)
 			{
 				speed = (event - InputEvent_Speed1 + 1);
+				rebake = true;
 			}
 			else if (event == InputEvent_Reload)
 			{
-				if (!displayImage(s_ilbmName))
+				if (!reloadImage(s_fileList.fileNames[s_currentFile]))
+					return;
+				rebake = true;
+			}
+			else if ((event == InputEvent_NextImage || event == InputEvent_PreviousImage) && numFiles > 1)
+			{
+				changeDirection = (event == InputEvent_NextImage) ? 1 : numFiles - 1;
+				changeImage = true;
+				restartPreload((s_currentFile + changeDirection) % numFiles);
+			}
+			else if (event == InputEvent_DumpFrameStats)
+			{
+				if (s_frameStats)
+					reportFrameStats();
+				else
+					printf("Start SuperCycler with -stats to collect frame statistics\n");
+			}
+		}
+		markFramePhase(s_frameStats, FramePhase_Input);
+
+		if (s_fileWatch && checkFileWatch(s_fileWatch))
+		{
+			reloadPending = true;
+			lastFileChange = readTimer();
+		}
+
+		if (reloadPending && timerTicksToMicroseconds(readTimer() - lastFileChange) >= WatchedFileSettleMicroseconds)
+		{
+			reloadPending = false;
+			if (!reloadImage(s_fileList.fileNames[s_currentFile]))
+				return;
+			rebake = true;
+		}
+
+		if (s_slideshowDelay && numFiles > 1 && !pause && !changeImage && !--framesUntilNextImage)
+		{
+			changeDirection = 1;
+			changeImage = true;
+		}
+
+		// Never wait for a decode here; the current image keeps cycling until the next one is ready
+		updatePreload();
+		if (changeImage && !s_preload.restartPending && isThreadFinished(s_preload.thread))
+		{
+			uint fileIndex = s_preload.fileIndex;
+			Ilbm* ilbm = finishPreload();
+
+			if (ilbm)
+			{
+				s_currentFile = fileIndex;
+				if (!showImage(ilbm))
 					return;
+
+				startPreload((fileIndex + 1) % numFiles);
+				watchCurrentFile();
+				reloadPending = false;
+				changeImage = false;
+				framesUntilNextImage = s_slideshowDelay;
+				rebake = true;
+			}
+			else
+			{
+				// Skip past files which cannot be loaded, and give up once back at the current one
+				uint nextFileIndex = (fileIndex + changeDirection) % numFiles;
+				if (nextFileIndex == s_currentFile)
+				{
+					changeImage = false;
+					framesUntilNextImage = s_slideshowDelay;
+					nextFileIndex = (s_currentFile + 1) % numFiles;
+				}
+				startPreload(nextFileIndex);
 			}
 		}
 
-		animatePalette(s_ilbm, frame, blend);
+		if (s_bakePaletteAnimation && rebake)
+		{
+			bakePaletteAnimation(s_paletteAnimation, frame, 65536 / speed, blend, DefaultMaxBakedPaletteBytes);
+			rebake = false;
+		}
+		markFramePhase(s_frameStats, FramePhase_ImageChanges);
+
+		const uint32_t* colors = s_bakePaletteAnimation
+			? animatePalette(s_paletteAnimation, frame, blend)
+			: animatePaletteChanges(s_paletteAnimation, frame, blend);
+		markFramePhase(s_frameStats, FramePhase_PaletteCompute);
+
+		if (colors)
+			uploadPalette(s_ilbm->palette.numColors, colors);
+		markFramePhase(s_frameStats, FramePhase_PaletteUpload);
 
 		if (!pause)
 			frame += (65536 / speed);
@@ -175,33 +520,93 @@ void displayLoop()
 
 int main(int argc, char** argv)
 {
-	if (argc != 2)
+	while (argc > 2 && argv[1][0] == '-')
 	{
-		printf("Usage: SuperCycler <filename>\n\n");
+		if (!strcmp(argv[1], "-bake"))
+			s_bakePaletteAnimation = true;
+		else if (!strcmp(argv[1], "-w"))
+			s_watchFile = true;
+		else if (!strcmp(argv[1], "-stats"))
+			s_collectFrameStats = true;
+		else if (!strcmp(argv[1], "-t") && argc > 3)
+		{
+			s_slideshowDelay = (uint) atoi(argv[2]) * VerticalBlanksPerSecond;
+			argv++;
+			argc--;
+		}
+		else
+			break;
+
+		argv++;
+		argc--;
+	}
+
+	if (argc < 2)
+	{
+		printf("Usage: SuperCycler [-bake] [-w] [-stats] [-t <seconds>] <file or directory> [more files or directories...]\n\n");
 		printf("This program displays IFF images with color cycling. Up to 16 ranges are supported.\n");
 		printf("The image should ideally be in one of the native Amiga resolutions, like 320x256, and max 256 colors.\n");
 		printf("Viewer controls:\n");
 		printf("  1-9 controls color cycling delay (1 = normal DPaint speed)\n");
-		printf("  Space pauses/restarts color cycling\n");
+		printf("  Space pauses/restarts color cycling (and the slideshow timer)\n");
 		printf("  R reloads the image from disk\n");
 		printf("  B toggles between linear blending, or hard stepping of colors\n");
+		printf("  N and P show the next and previous image, when several are given\n");
+		printf("  F prints frame statistics, with -stats\n");
 		printf("  Esc or LMB exits viewer\n");
+		printf("Options:\n");
+		printf("  -bake precomputes a full cycle of palettes, instead of computing each frame's palette as it is shown\n");
+		printf("  -w reloads the image whenever its file is saved\n");
+		printf("  -stats times every frame, and prints a summary on exit\n");
+		printf("  -t moves on to the next image after this many seconds\n");
 		return 0;
 	}
 
-	GfxBase = (struct GfxBase*) OpenLibrary("graphics.library", 39);
-	IntuitionBase = (struct IntuitionBase*) OpenLibrary("intuition.library", 39);
+	for (int arg = 1; arg < argc; ++arg)
+		if (!addFileOrDirectory(&s_fileList, argv[arg]))
+		{
+			printf("Unable to read %s\n", argv[arg]);
+			freeFileList(&s_fileList);
+			return -1;
+		}
 
-	strcpy(s_ilbmName, argv[1]);
-	
-	if (!displayImage(argv[1]))
+	if (!s_fileList.numFiles)
 	{
-		cleanup();
+		printf("No files to show\n");
+		freeFileList(&s_fileList);
 		return -1;
 	}
 
+	initArenaAllocator(&s_imageArenas[0], 0);
+	initArenaAllocator(&s_imageArenas[1], 0);
+
+	if (!initScreenAndInput())
+	{
+		freeFileList(&s_fileList);
+		return -1;
+	}
+
+	s_frameStatsFileName = getenv("SUPERCYCLER_FRAME_STATS");
+	if ((s_collectFrameStats || s_frameStatsFileName) && !(s_frameStats = createFrameStats(VerticalBlanksPerSecond)))
+		printf("Unable to open timer; frame statistics are off\n");
+
+	if (s_watchFile && !initTimer())
+	{
+		printf("Unable to open timer; files are not watched\n");
+		s_watchFile = false;
+	}
+
+	// Start with the first file that loads
+	while (!displayImage(s_fileList.fileNames[s_currentFile]))
+		if (++s_currentFile == s_fileList.numFiles)
+		{
+			cleanup();
+			return -1;
+		}
+
+	watchCurrentFile();
 	displayLoop();
 	cleanup();
 		
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,262 @@
+
+#include "SyntheticImage.h"
+#include "ChunkyToPlanar.h"
+#include "Ilbm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { BmhdSize = 20 };
+enum { CrngSize = 8 };
+
+// Colors cycle at normal DPaint speed, 60 steps per second
+enum { SyntheticColorRangeRate = 16384 };
+
+typedef struct
+{
+	uint8_t* data;
+	size_t size;
+} Writer;
+
+static void writeBytes(Writer* writer, const void* data, size_t size)
+{
+	memcpy(writer->data + writer->size, data, size);
+	writer->size += size;
+}
+
+static void writeUint8(Writer* writer, uint value)
+{
+	writer->data[writer->size++] = (uint8_t) value;
+}
+
+static void writeUint16(Writer* writer, uint value)
+{
+	writeUint8(writer, value >> 8);
+	writeUint8(writer, value);
+}
+
+static void writeUint32(Writer* writer, uint32_t value)
+{
+	writeUint16(writer, value >> 16);
+	writeUint16(writer, value & 0xffff);
+}
+
+// Starts a chunk, and returns where its size goes once the contents are known
+static size_t beginChunk(Writer* writer, uint32_t id)
+{
+	writeUint32(writer, id);
+	writeUint32(writer, 0);
+	return writer->size;
+}
+
+static void endChunk(Writer* writer, size_t contentsOffset)
+{
+	uint32_t size = (uint32_t) (writer->size - contentsOffset);
+	uint8_t* sizePtr = writer->data + contentsOffset - 4;
+	sizePtr[0] = (uint8_t) (size >> 24);
+	sizePtr[1] = (uint8_t) (size >> 16);
+	sizePtr[2] = (uint8_t) (size >> 8);
+	sizePtr[3] = (uint8_t) size;
+
+	if (size & 1)
+		writeUint8(writer, 0);
+}
+
+// Worst case ByteRun1 output is one count byte per 128 literal bytes, rounded up
+static size_t getMaxByteRun1Size(uint bytes)
+{
+	return bytes + (bytes + 127) / 128;
+}
+
+static void encodeByteRun1(Writer* writer, const uint8_t* source, uint bytes)
+{
+	uint position = 0;
+	while (position < bytes)
+	{
+		uint repeatLength = 1;
+		while (position + repeatLength < bytes && repeatLength < 128 && source[position + repeatLength] == source[position])
+			repeatLength++;
+
+		if (repeatLength >= 3)
+		{
+			writeUint8(writer, 257 - repeatLength);
+			writeUint8(writer, source[position]);
+			position += repeatLength;
+			continue;
+		}
+
+		// Literals run until the next three equal bytes
+		uint literalLength = 0;
+		while (position + literalLength < bytes && literalLength < 128
+			&& !(position + literalLength + 2 < bytes
+				&& source[position + literalLength] == source[position + literalLength + 1]
+				&& source[position + literalLength] == source[position + literalLength + 2]))
+			literalLength++;
+
+		writeUint8(writer, literalLength - 1);
+		writeBytes(writer, source + position, literalLength);
+		position += literalLength;
+	}
+}
+
+static void writeBodyRowPart(Writer* writer, const uint8_t* source, uint bytes, bool compressed)
+{
+	if (compressed)
+		encodeByteRun1(writer, source, bytes);
+	else
+		writeBytes(writer, source, bytes);
+}
+
+static uint32_t nextRandom(uint32_t* state)
+{
+	// xorshift32; the state must never be zero
+	uint32_t value = *state;
+	value ^= value << 13;
+	value ^= value >> 17;
+	value ^= value << 5;
+	*state = value;
+	return value;
+}
+
+// Runs of equal pixels with lengths spread evenly around runLength, each continuing the color of
+//  the run above it half of the time, so that images look like blocky pictures rather than noise
+static void generateRow(uint8_t* row, const uint8_t* rowAbove, uint width, uint depth, uint runLength, uint32_t* random)
+{
+	uint colorMask = (1u << depth) - 1;
+	uint x = 0;
+	while (x < width)
+	{
+		uint length = 1 + nextRandom(random) % (2 * runLength - 1);
+		uint8_t color = (rowAbove && (nextRandom(random) & 1)) ? rowAbove[x] : (uint8_t) (nextRandom(random) & colorMask);
+
+		if (length > width - x)
+			length = width - x;
+		memset(row + x, color, length);
+		x += length;
+	}
+}
+
+void setDefaultSyntheticImageParams(SyntheticImageParams* params)
+{
+	memset(params, 0, sizeof *params);
+	params->width = 320;
+	params->height = 256;
+	params->depth = 5;
+	params->compressed = true;
+	params->runLength = 8;
+	params->numColorRanges = 4;
+	params->seed = 1;
+}
+
+void* createSyntheticImage(const SyntheticImageParams* params, size_t* size)
+{
+	uint width = params->width;
+	uint height = params->height;
+	uint depth = params->depth;
+	uint numColors = 1u << depth;
+
+	if (!width || width > 0xffff || !height || height > 0xffff || !depth || depth > MaxIlbmPlanes
+		|| !params->runLength || params->numColorRanges > MaxIlbmColorRanges || params->numColorRanges > numColors / 2)
+		return 0;
+
+	uint bytesPerRow = ((width + 15) / 16) * 2;
+	uint paddedWidth = bytesPerRow * 8;
+	uint rowPartBytes = params->pbm ? width : bytesPerRow;
+	uint rowParts = params->pbm ? 1 : depth;
+	size_t maxBodySize = (size_t) height * rowParts * getMaxByteRun1Size(rowPartBytes);
+	size_t maxSize = 12 + 8 + BmhdSize + 8 + 3 * numColors + 1 + params->numColorRanges * (8 + CrngSize) + 8 + maxBodySize + 1;
+
+	Writer writer;
+	writer.size = 0;
+	writer.data = (uint8_t*) malloc(maxSize);
+	uint8_t* rows = (uint8_t*) calloc(2, paddedWidth);
+	uint8_t* planeBuffer = (uint8_t*) malloc(depth * bytesPerRow);
+	if (!writer.data || !rows || !planeBuffer)
+	{
+		free(writer.data);
+		free(rows);
+		free(planeBuffer);
+		return 0;
+	}
+
+	size_t form = beginChunk(&writer, ID_FORM);
+	writeUint32(&writer, params->pbm ? ID_PBM : ID_ILBM);
+
+	size_t bmhd = beginChunk(&writer, ID_BMHD);
+	writeUint16(&writer, width);
+	writeUint16(&writer, height);
+	writeUint16(&writer, 0);
+	writeUint16(&writer, 0);
+	writeUint8(&writer, depth);
+	writeUint8(&writer, 0);
+	writeUint8(&writer, params->compressed ? 1 : 0);
+	writeUint8(&writer, 0);
+	writeUint16(&writer, 0);
+	writeUint8(&writer, 1);
+	writeUint8(&writer, 1);
+	writeUint16(&writer, width);
+	writeUint16(&writer, height);
+	endChunk(&writer, bmhd);
+
+	// A ramp through hue per color range, so that cycling is easy to see
+	size_t cmap = beginChunk(&writer, ID_CMAP);
+	for (uint color = 0; color < numColors; ++color)
+	{
+		uint phase = (color * 256 / numColors) & 0xff;
+		writeUint8(&writer, phase);
+		writeUint8(&writer, 255 - phase);
+		writeUint8(&writer, (phase * 3) & 0xff);
+	}
+	endChunk(&writer, cmap);
+
+	// The palette is split into equally large ranges, alternating in direction
+	uint rangeColors = params->numColorRanges ? numColors / params->numColorRanges : 0;
+	for (uint range = 0; range < params->numColorRanges; ++range)
+	{
+		size_t crng = beginChunk(&writer, ID_CRNG);
+		writeUint16(&writer, 0);
+		writeUint16(&writer, SyntheticColorRangeRate / (range + 1));
+		writeUint16(&writer, (range & 1) ? 3 : 1);
+		writeUint8(&writer, range * rangeColors);
+		writeUint8(&writer, (range + 1) * rangeColors - 1);
+		endChunk(&writer, crng);
+	}
+
+	ChunkyToPlanarRowFunc chunkyToPlanarRow = selectChunkyToPlanarRowFunc(depth);
+	uint8_t* planeRows[MaxIlbmPlanes];
+	for (uint plane = 0; plane < depth; ++plane)
+		planeRows[plane] = planeBuffer + plane * bytesPerRow;
+
+	uint32_t random = params->seed ? params->seed : 1;
+	size_t body = beginChunk(&writer, ID_BODY);
+	for (uint y = 0; y < height; ++y)
+	{
+		uint8_t* row = rows + (y & 1) * paddedWidth;
+		const uint8_t* rowAbove = y ? rows + ((y - 1) & 1) * paddedWidth : 0;
+		generateRow(row, rowAbove, width, depth, params->runLength, &random);
+
+		if (params->pbm)
+			writeBodyRowPart(&writer, row, width, params->compressed);
+		else
+		{
+			chunkyToPlanarRow(row, width, planeRows);
+			for (uint plane = 0; plane < depth; ++plane)
+				writeBodyRowPart(&writer, planeRows[plane], bytesPerRow, params->compressed);
+		}
+	}
+	endChunk(&writer, body);
+	endChunk(&writer, form);
+
+	free(rows);
+	free(planeBuffer);
+	*size = writer.size;
+	return writer.data;
+}
+
+void formatSyntheticImageParams(char* buffer, size_t bufferSize, const SyntheticImageParams* params)
+{
+	snprintf(buffer, bufferSize, "%s %ux%ux%u %s run %u, %u ranges", params->pbm ? "PBM" : "ILBM",
+		params->width, params->height, params->depth, params->compressed ? "RLE" : "raw",
+		params->runLength, params->numColorRanges);
+}
@@ -0,0 +1,33 @@
+
+#ifndef SYNTHETICIMAGE_H
+#define SYNTHETICIMAGE_H
+
+#include "Types.h"
+
+#include <stddef.h>
+
+// Builds ILBM and PBM files of any size and shape in memory, for benchmarks and tests which need
+//  images that ExamplePictures does not have
+
+typedef struct
+{
+	uint width;
+	uint height;
+	uint depth;	// 1-8 bitplanes
+	bool pbm;	// Chunky PBM BODY instead of ILBM bitplanes
+	bool compressed;	// ByteRun1 BODY
+	uint runLength;	// Average length of runs of equal pixels; 1 gives noise, which barely compresses
+	uint numColorRanges;	// Active CRNG chunks, at most MaxIlbmColorRanges
+	uint32_t seed;
+} SyntheticImageParams;
+
+// 320x256, 5 planes, ILBM, compressed, runs of 8 pixels, 4 color ranges
+void setDefaultSyntheticImageParams(SyntheticImageParams* params);
+
+// Returns a whole IFF FORM, allocated with malloc(), or 0 if the parameters are out of range
+void* createSyntheticImage(const SyntheticImageParams* params, size_t* size);
+
+// Describes the parameters like "ILBM 320x256x5 RLE run 8, 4 ranges"
+void formatSyntheticImageParams(char* buffer, size_t bufferSize, const SyntheticImageParams* params);
+
+#endif
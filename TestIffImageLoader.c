@@ -1,25 +1,97 @@
 
+#include "IffParseStats.h"
 #include "Ilbm.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-void parseErrorCallback(const char* message)
+void parseErrorCallback(void* context, const IffErrorLocation* location, const char* message)
 {
-	printf("Error: %s\n", message);
+	char where[512];
+	formatIffErrorLocation(where, sizeof where, location);
+	printf("Error: %s (%s)\n", message, where);
 }
 
 int main(int argc, char** argv)
 {
+	LoadIffImageOptions options = { 0 };
+	ArenaAllocator arena;
+	bool useArena = false;
+	IffParseStats parseStats;
+	bool collectParseStats = false;
+
+	initIffParseStats(&parseStats);
+
+	while (argc > 2 && argv[1][0] == '-')
+	{
+		if (!strcmp(argv[1], "-stream"))
+			options.streamWindowSize = DefaultIffStreamWindowSize;
+		else if (!strcmp(argv[1], "-readblock") && argc > 3)
+		{
+			options.readBlockSize = (uint) atoi(argv[2]);
+			argv++;
+			argc--;
+		}
+		else if (!strcmp(argv[1], "-parallel"))
+			options.parallelDecode = true;
+		else if (!strcmp(argv[1], "-chunky"))
+			options.chunkyOutput = true;
+		else if (!strcmp(argv[1], "-interleaved"))
+			options.interleaved = true;
+		else if (!strcmp(argv[1], "-arena"))
+			useArena = true;
+		else if (!strcmp(argv[1], "-parsestats"))
+			collectParseStats = true;
+		else if (!strcmp(argv[1], "-trace"))
+			collectParseStats = parseStats.trace = true;
+		else
+			break;
+
+		argv++;
+		argc--;
+	}
+
 	if (argc != 2)
 	{
-		printf("usage: TestIlbmParser <filename>\n");
+		printf("usage: TestIlbmParser [-stream] [-readblock <bytes>] [-parallel] [-chunky] [-interleaved] [-arena] [-parsestats] [-trace] <filename>\n");
 		return 0;
 	}
 
-	Ilbm* ilbm = loadIffImage(argv[1], parseErrorCallback);
+	if (useArena)
+	{
+		initArenaAllocator(&arena, 0);
+		options.allocator = &arena.allocator;
+	}
+
+	if (collectParseStats)
+	{
+		if (!initTimer())
+		{
+			printf("Unable to open timer\n");
+			return 0;
+		}
+		options.chunkEndFunc = collectIffChunkTiming;
+		options.chunkEventContext = &parseStats;
+	}
+
+	Ilbm* ilbm = loadIffImageWithOptions(argv[1], &options, parseErrorCallback, 0);
 	
 	if (ilbm)
 		freeIlbm(ilbm);
+
+	if (useArena)
+	{
+		printf("Arena: %u allocations, %u bytes in total, %u bytes at peak, %u blocks\n", arena.stats.numAllocations,
+			(uint) arena.stats.totalBytes, (uint) arena.stats.peakBytes, arena.stats.numBlockAllocations);
+		freeArenaAllocator(&arena);
+	}
+
+	if (collectParseStats)
+	{
+		printIffParseStats(&parseStats);
+		shutdownTimer();
+	}
 	
 	return 0;
 
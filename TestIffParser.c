@@ -1,11 +1,15 @@
 
+#include "IffParseStats.h"
 #include "parseIff.h"
 
 #include <stdio.h>
+#include <string.h>
 
-void parseErrorCallback(const char* message)
+void parseErrorCallback(void* context, const IffErrorLocation* location, const char* message)
 {
-	printf("Error: %s\n", message);
+	char where[512];
+	formatIffErrorLocation(where, sizeof where, location);
+	printf("Error: %s (%s)\n", message, where);
 }
 
 bool handleILBM(void* state, void* buffer, unsigned int size)
@@ -31,15 +35,43 @@ int main(int argc, char** argv)
 		{ ID_BODY, handleBODY },
 		{ 0, 0 },
 	};
-	static IffParseRules parseRules = { parseErrorCallback, chunkHandlers };
+	static IffParseRules parseRules = { parseErrorCallback, 0, chunkHandlers };
+	IffParseStats parseStats;
+	bool trace = false;
+
+	if (argc == 3 && !strcmp(argv[1], "-trace"))
+	{
+		trace = true;
+		argv++;
+		argc--;
+	}
 
 	if (argc != 2)
 	{
-		printf("usage: TestIffParser <filename>\n");
+		printf("usage: TestIffParser [-trace] <filename>\n");
 		return 0;
 	}
+
+	if (trace)
+	{
+		if (!initTimer())
+		{
+			printf("Unable to open timer\n");
+			return 0;
+		}
+		initIffParseStats(&parseStats);
+		parseStats.trace = true;
+		parseRules.chunkEndFunc = collectIffChunkTiming;
+		parseRules.chunkEventContext = &parseStats;
+	}
 	
 	parseIff(argv[1], &parseRules);
+
+	if (trace)
+	{
+		printIffParseStats(&parseStats);
+		shutdownTimer();
+	}
 	
 	return 0;
 }
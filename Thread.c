@@ -0,0 +1,170 @@
+
+#include "Thread.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef AMIGA
+#include <dos/dostags.h>
+#include <proto/dos.h>
+#include <proto/exec.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef AMIGA
+enum { ThreadStackSize = 32 * 1024 };
+enum { ThreadPriority = -1 };	// Below the caller, so that it never delays the display
+#endif
+
+struct Thread
+{
+	ThreadFunc func;
+	void* argument;
+	bool running;
+	bool finished;
+#ifdef AMIGA
+	struct Message startupMessage;	// Sent to the process, which replies once func has returned
+	struct MsgPort* replyPort;
+#else
+	pthread_t handle;
+	pthread_mutex_t finishedMutex;
+#endif
+};
+
+#ifdef AMIGA
+static void processEntry(void)
+{
+	struct Process* process = (struct Process*) FindTask(0);
+	WaitPort(&process->pr_MsgPort);
+	struct Message* message = GetMsg(&process->pr_MsgPort);
+	Thread* thread = (Thread*) ((char*) message - offsetof(Thread, startupMessage));
+
+	thread->func(thread->argument);
+
+	// The process must be gone before the caller can unload the code it runs; the Forbid()
+	//  lasts until it has exited
+	Forbid();
+	ReplyMsg(message);
+}
+#else
+static void* threadEntry(void* thread_)
+{
+	Thread* thread = (Thread*) thread_;
+	thread->func(thread->argument);
+
+	pthread_mutex_lock(&thread->finishedMutex);
+	thread->finished = true;
+	pthread_mutex_unlock(&thread->finishedMutex);
+	return 0;
+}
+#endif
+
+Thread* startThread(ThreadFunc func, void* argument)
+{
+	Thread* thread = malloc(sizeof(Thread));
+	if (!thread)
+	{
+		func(argument);
+		return 0;
+	}
+
+	thread->func = func;
+	thread->argument = argument;
+	thread->running = false;
+	thread->finished = false;
+
+#ifdef AMIGA
+	if ((thread->replyPort = CreateMsgPort()))
+	{
+		struct Process* process = CreateNewProcTags(
+			NP_Entry, (ULONG) processEntry,
+			NP_Name, (ULONG) "Thread",
+			NP_StackSize, ThreadStackSize,
+			NP_Priority, ThreadPriority,
+			TAG_DONE);
+		if (process)
+		{
+			thread->startupMessage.mn_Node.ln_Type = NT_MESSAGE;
+			thread->startupMessage.mn_ReplyPort = thread->replyPort;
+			thread->startupMessage.mn_Length = sizeof(struct Message);
+			PutMsg(&process->pr_MsgPort, &thread->startupMessage);
+			thread->running = true;
+			return thread;
+		}
+		DeleteMsgPort(thread->replyPort);
+	}
+#else
+	if (!pthread_mutex_init(&thread->finishedMutex, 0))
+	{
+		if (!pthread_create(&thread->handle, 0, threadEntry, thread))
+		{
+			thread->running = true;
+			return thread;
+		}
+		pthread_mutex_destroy(&thread->finishedMutex);
+	}
+#endif
+
+	func(argument);
+	thread->finished = true;
+	return thread;
+}
+
+void joinThread(Thread* thread)
+{
+	if (!thread)
+		return;
+
+#ifdef AMIGA
+	if (thread->running)
+	{
+		if (!thread->finished)
+		{
+			WaitPort(thread->replyPort);
+			GetMsg(thread->replyPort);
+		}
+		DeleteMsgPort(thread->replyPort);
+	}
+#else
+	if (thread->running)
+	{
+		pthread_join(thread->handle, 0);
+		pthread_mutex_destroy(&thread->finishedMutex);
+	}
+#endif
+
+	free(thread);
+}
+
+bool isThreadFinished(Thread* thread)
+{
+	if (!thread)
+		return true;
+
+#ifdef AMIGA
+	if (thread->running && !thread->finished && GetMsg(thread->replyPort))
+		thread->finished = true;
+#else
+	if (thread->running)
+	{
+		pthread_mutex_lock(&thread->finishedMutex);
+		bool finished = thread->finished;
+		pthread_mutex_unlock(&thread->finishedMutex);
+		return finished;
+	}
+#endif
+
+	return thread->finished;
+}
+
+uint getNumHardwareThreads(void)
+{
+#ifndef AMIGA
+	long numProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+	if (numProcessors > 1)
+		return (uint) numProcessors;
+#endif
+	return 1;
+}
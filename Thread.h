@@ -0,0 +1,24 @@
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "Types.h"
+
+typedef void (*ThreadFunc)(void* argument);
+
+typedef struct Thread Thread;
+
+// Runs func(argument) on a new thread; on AmigaOS that is a DOS process of its own, one
+//  priority below the caller. It shares the C library with the caller there, so func must
+//  leave the C heap and stdio alone; allocators and DOS calls are fine. When the OS refuses
+//  to create another thread, func runs to completion before startThread() returns;
+//  joinThread() must be called in either case.
+Thread* startThread(ThreadFunc func, void* argument);
+void joinThread(Thread* thread);
+
+// True once func has returned, so that joinThread() will not block
+bool isThreadFinished(Thread* thread);
+
+uint getNumHardwareThreads(void);
+
+#endif
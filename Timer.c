@@ -0,0 +1,82 @@
+
+#include "Timer.h"
+
+#ifdef AMIGA
+#include <devices/timer.h>
+#include <proto/exec.h>
+#include <proto/timer.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef AMIGA
+
+struct Device* TimerBase = 0;
+static struct timerequest s_timerRequest;
+static uint64_t s_ticksPerSecond = 0;
+
+bool initTimer(void)
+{
+	if (TimerBase)
+		return true;
+
+	if (OpenDevice((STRPTR) TIMERNAME, UNIT_ECLOCK, (struct IORequest*) &s_timerRequest, 0))
+		return false;
+
+	TimerBase = s_timerRequest.tr_node.io_Device;
+
+	struct EClockVal eClock;
+	s_ticksPerSecond = ReadEClock(&eClock);
+	return true;
+}
+
+void shutdownTimer(void)
+{
+	if (!TimerBase)
+		return;
+
+	CloseDevice((struct IORequest*) &s_timerRequest);
+	TimerBase = 0;
+}
+
+TimerTicks readTimer(void)
+{
+	struct EClockVal eClock;
+	ReadEClock(&eClock);
+	return ((TimerTicks) eClock.ev_hi << 32) | eClock.ev_lo;
+}
+
+uint64_t getTimerTicksPerSecond(void)
+{
+	return s_ticksPerSecond;
+}
+
+#else
+
+bool initTimer(void)
+{
+	return true;
+}
+
+void shutdownTimer(void)
+{
+}
+
+TimerTicks readTimer(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (TimerTicks) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+uint64_t getTimerTicksPerSecond(void)
+{
+	return 1000000000u;
+}
+
+#endif
+
+double timerTicksToMicroseconds(TimerTicks ticks)
+{
+	return (double) ticks * 1e6 / (double) getTimerTicksPerSecond();
+}
@@ -0,0 +1,19 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "Types.h"
+
+// A monotonic clock for measuring how long things take: the E-clock on AmigaOS (about 0.7 MHz),
+//  CLOCK_MONOTONIC elsewhere
+
+typedef uint64_t TimerTicks;
+
+// Must succeed before readTimer() is used
+bool initTimer(void);
+void shutdownTimer(void);
+
+TimerTicks readTimer(void);
+uint64_t getTimerTicksPerSecond(void);
+double timerTicksToMicroseconds(TimerTicks ticks);
+
+#endif
@@ -1,17 +1,32 @@
 
 #include "parseIff.h"
+#include "ReadAhead.h"
 
 #include <stdio.h>
 #include <stdlib.h>
-
-//#define DEBUG_IFF_PARSER
+#include <string.h>
+
+#ifdef AMIGA
+#include <dos/dos.h>
+#include <proto/dos.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 typedef struct
 {
 	const char* fileName;
-	FILE* fileHandle;
+	ReadAhead* readAhead;
+	const uint8_t* memory;
+	const uint8_t* memoryEnd;
+	uint32_t fileOffset;
+	IffErrorLocation location;
 	uint32_t compositeBytesLeft;
 	void* chunkBuffer;
+	IffChunkTiming chunkTiming;	// Of the chunk being processed, when rules->chunkEndFunc is set
 } IffParseContext;
 
 typedef struct
@@ -27,20 +42,97 @@ typedef struct
 	uint32_t size;
 } IffChunkHeader;
 
+uint16_t readIffUint16(const void* source)
+{
+	const uint8_t* bytes = (const uint8_t*) source;
+	return (uint16_t) ((bytes[0] << 8) | bytes[1]);
+}
+
+uint32_t readIffUint32(const void* source)
+{
+	const uint8_t* bytes = (const uint8_t*) source;
+	return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8) | bytes[3];
+}
+
+static void decodeIffHeader(IffHeader* iffHeader)
+{
+	iffHeader->compositeType = readIffUint32(&iffHeader->compositeType);
+	iffHeader->compositeSize = readIffUint32(&iffHeader->compositeSize);
+	iffHeader->dataType = readIffUint32(&iffHeader->dataType);
+}
+
 static bool validateIffHeader(const IffHeader* iffHeader)
 {
 	if (iffHeader->compositeType != ID_FORM)
 		return false;
-	if (iffHeader->compositeSize > 16*1024*1024 || iffHeader->compositeSize < 4)
+	if (iffHeader->compositeSize < 4)
 		return false;
 
 	return true;
 }
 
-static void cleanup(IffParseContext* parseContext)
+void formatIffErrorLocation(char* buffer, size_t bufferSize, const IffErrorLocation* location)
 {
-	if (parseContext->fileHandle)
-		fclose(parseContext->fileHandle);
+	const char* fileName = location->fileName ? location->fileName : "memory";
+	uint32_t id = location->chunkId;
+
+	if (id)
+		snprintf(buffer, bufferSize, "%s, %c%c%c%c chunk at offset %u", fileName,
+			(char) (id >> 24), (char) (id >> 16), (char) (id >> 8), (char) id, location->fileOffset);
+	else
+		snprintf(buffer, bufferSize, "%s, offset %u", fileName, location->fileOffset);
+}
+
+static void reportError(IffParseContext* parseContext, const IffParseRules* rules, const char* message)
+{
+	parseContext->location.fileName = parseContext->fileName;
+	if (!parseContext->location.chunkId)
+		parseContext->location.fileOffset = parseContext->fileOffset;
+
+	rules->errorFunc(rules->errorContext, &parseContext->location, message);
+}
+
+static void reportFileError(const char* fileName, const IffParseRules* rules, const char* message)
+{
+	IffErrorLocation location = { fileName, 0, 0 };
+	rules->errorFunc(rules->errorContext, &location, message);
+}
+
+// Time is only measured when someone is listening, so that parsing without instrumentation
+//  does not need the timer
+static TimerTicks startChunkTiming(const IffParseRules* rules)
+{
+	return rules->chunkEndFunc ? readTimer() : 0;
+}
+
+static void stopChunkTiming(const IffParseRules* rules, TimerTicks* ticks, TimerTicks start)
+{
+	if (rules->chunkEndFunc)
+		*ticks += readTimer() - start;
+}
+
+// The chunk header has been read, or for FORM, the file header
+static void beginChunkEvent(IffParseContext* parseContext, const IffParseRules* rules, uint32_t id, uint32_t size)
+{
+	parseContext->chunkTiming.id = id;
+	parseContext->chunkTiming.size = size;
+
+	if (rules->chunkBeginFunc)
+		rules->chunkBeginFunc(rules->chunkEventContext, id, size, parseContext->chunkTiming.fileOffset);
+}
+
+static void endChunkEvent(IffParseContext* parseContext, const IffParseRules* rules, bool succeeded)
+{
+	parseContext->chunkTiming.succeeded = succeeded;
+
+	if (rules->chunkEndFunc)
+		rules->chunkEndFunc(rules->chunkEventContext, &parseContext->chunkTiming);
+}
+
+static void cleanup(IffParseContext* parseContext, const IffParseRules* rules)
+{
+	freeReadAhead(parseContext->readAhead);
+	releaseMemory(rules->allocator, parseContext->chunkBuffer);
 }
 
 static bool validateIffChunkHeader(const IffChunkHeader* chunkHeader, unsigned int compositeBytesLeft)
@@ -53,104 +145,192 @@ static bool validateIffChunkHeader(const IffChunkHeader* chunkHeader, unsigned i
 
 static bool readBytesFromStream(IffParseContext* parseContext, const IffParseRules* rules, void* buffer, size_t bytes)
 {
-	if (fread(buffer, bytes, 1, parseContext->fileHandle) != 1)
+	TimerTicks start = startChunkTiming(rules);
+
+	if (parseContext->memory && bytes <= (size_t) (parseContext->memoryEnd - parseContext->memory))
+	{
+		memcpy(buffer, parseContext->memory, bytes);
+		parseContext->memory += bytes;
+	}
+	else if (parseContext->memory || !readReadAhead(parseContext->readAhead, buffer, bytes))
 	{
 		char buf[1024];
 		sprintf(buf, "Unable to read %d bytes", (int) bytes);
-		rules->errorFunc(buf);
+		reportError(parseContext, rules, buf);
 		return false;
 	}
+
+	stopChunkTiming(rules, &parseContext->chunkTiming.readTicks, start);
 	
 	parseContext->compositeBytesLeft -= bytes;
+	parseContext->fileOffset += bytes;
 	
 	return true;
 }
 
-static bool processChunkHeader(IffParseContext* parseContext, const IffParseRules* rules, IffChunkHeader* chunkHeader)
+// Returns the bytes in place, when they are in memory already, or within a single block of the
+//  read-ahead; otherwise returns 0, and they are still to be read
+static void* borrowBytesFromStream(IffParseContext* parseContext, const IffParseRules* rules, size_t bytes)
 {
-#ifdef DEBUG_IFF_PARSER
-	printf("DEBUG_IFF_PARSER: Reading IFF chunk header from file\n");
-#endif
+	TimerTicks start = startChunkTiming(rules);
+
+	void* data;
+	if (parseContext->memory)
+	{
+		if (bytes > (size_t) (parseContext->memoryEnd - parseContext->memory))
+			return 0;
+
+		data = (void*) parseContext->memory;
+		parseContext->memory += bytes;
+	}
+	else
+		data = (void*) borrowReadAhead(parseContext->readAhead, bytes);
+
+	stopChunkTiming(rules, &parseContext->chunkTiming.readTicks, start);
+
+	if (!data)
+		return 0;
+
+	parseContext->compositeBytesLeft -= bytes;
+	parseContext->fileOffset += bytes;
+
+	return data;
+}
 
-	if (parseContext->compositeBytesLeft < sizeof chunkHeader)
+static bool processChunkHeader(IffParseContext* parseContext, const IffParseRules* rules, IffChunkHeader* chunkHeader)
+{
+	if (parseContext->compositeBytesLeft < sizeof *chunkHeader)
 	{
-		rules->errorFunc("Malformed IFF file");
+		reportError(parseContext, rules, "Malformed IFF file");
 		return false;
 	}
 
+	uint32_t chunkHeaderOffset = parseContext->fileOffset;
+
 	if (!readBytesFromStream(parseContext, rules, chunkHeader, sizeof *chunkHeader))
 		return false;
-	
-#ifdef DEBUG_IFF_PARSER
-	printf("DEBUG_IFF_PARSER: Encountered chunk %c%c%c%c, size %u\n", (char) (chunkHeader->id >> 24), (char) (chunkHeader->id >> 16), (char) (chunkHeader->id >> 8), (char) chunkHeader->id, chunkHeader->size);
-#endif
+
+	chunkHeader->id = readIffUint32(&chunkHeader->id);
+	parseContext->location.chunkId = chunkHeader->id;
+	parseContext->location.fileOffset = chunkHeaderOffset;
+	if (rules->handlerLocation)
+	{
+		rules->handlerLocation->fileName = parseContext->fileName;
+		rules->handlerLocation->chunkId = chunkHeader->id;
+		rules->handlerLocation->fileOffset = chunkHeaderOffset;
+	}
+	chunkHeader->size = readIffUint32(&chunkHeader->size);
 
 	if (!validateIffChunkHeader(chunkHeader, parseContext->compositeBytesLeft))
 	{
 		char buf[1024];
 		sprintf(buf, "Invalid IFF chunk header in file");
-		rules->errorFunc(buf);
+		reportError(parseContext, rules, buf);
 		return false;
 	}
 
 	return true;
 }
 
-static bool invokeChunkHandler(IffParseContext* parseContext, const IffParseRules* rules, uint32_t id, void* buffer, uint size, bool handlerRequired)
+static const IffChunkHandler* findChunkHandler(const IffParseRules* rules, uint32_t id)
 {
-#ifdef DEBUG_IFF_PARSER
-	printf("DEBUG_IFF_PARSER: Locating chunk handler\n");
-#endif
-
-	IffChunkHandler* chunkHandler;
+	const IffChunkHandler* chunkHandler;
 	for (chunkHandler = rules->chunkHandlers; chunkHandler->id; chunkHandler++)
 		if (chunkHandler->id == id)
-			break;
+			return chunkHandler;
 
-	if (chunkHandler->id)
-	{
-#ifdef DEBUG_IFF_PARSER
-		printf("DEBUG_IFF_PARSER: Invoking chunk handler\n");
-#endif
-		bool result = chunkHandler->handlerFunc(rules->chunkHandlerState, buffer, size);
-#ifdef DEBUG_IFF_PARSER
-		printf("DEBUG_IFF_PARSER: Chunk handling %s\n", result ? "succeeded" : "failed");
-#endif
-		if (!result)
-			return false;
-	}
-	else
+	return 0;
+}
+
+static bool invokeChunkHandler(IffParseContext* parseContext, const IffParseRules* rules, uint32_t id, void* buffer, uint size, bool handlerRequired)
+{
+	const IffChunkHandler* chunkHandler = findChunkHandler(rules, id);
+
+	if (!chunkHandler)
+		return !handlerRequired;
+
+	parseContext->chunkTiming.handled = true;
+
+	TimerTicks start = startChunkTiming(rules);
+	bool result = chunkHandler->handlerFunc
+		? chunkHandler->handlerFunc(rules->chunkHandlerState, buffer, size)
+		: chunkHandler->streamFunc(rules->chunkHandlerState, buffer, size, 0, size);
+	stopChunkTiming(rules, &parseContext->chunkTiming.handlerTicks, start);
+
+	return result;
+}
+
+static bool streamChunkData(IffParseContext* parseContext, const IffParseRules* rules, const IffChunkHandler* chunkHandler, const IffChunkHeader* chunkHeader)
+{
+	parseContext->chunkTiming.handled = true;
+
+	uint32_t chunkOffset = 0;
+	do
 	{
-		if (handlerRequired)
+		uint32_t windowSize = chunkHeader->size - chunkOffset;
+		if (windowSize > rules->streamWindowSize)
+			windowSize = rules->streamWindowSize;
+
+		// Windows end early at the end of a block, so that they never need to be copied
+		TimerTicks readStart = startChunkTiming(rules);
+		size_t available = getReadAheadAvailable(parseContext->readAhead);
+		stopChunkTiming(rules, &parseContext->chunkTiming.readTicks, readStart);
+		if (windowSize > available && available)
+			windowSize = (uint32_t) available;
+
+		void* window = borrowBytesFromStream(parseContext, rules, windowSize);
+		if (!window)
 		{
-#ifdef DEBUG_IFF_PARSER
-			printf("DEBUG_IFF_PARSER: No chunk handler found, parsing failed\n");
-#endif
+			char buf[1024];
+			sprintf(buf, "Unable to read %d bytes", (int) windowSize);
+			reportError(parseContext, rules, buf);
 			return false;
 		}
-		else
-		{
-#ifdef DEBUG_IFF_PARSER
-			printf("DEBUG_IFF_PARSER: No chunk handler found, chunk will be ignored\n");
-#endif
-			return true;
-		}
-	}
+
+		TimerTicks handlerStart = startChunkTiming(rules);
+		bool result = chunkHandler->streamFunc(rules->chunkHandlerState, window, windowSize, chunkOffset, chunkHeader->size);
+		stopChunkTiming(rules, &parseContext->chunkTiming.handlerTicks, handlerStart);
+		if (!result)
+			return false;
+
+		chunkOffset += windowSize;
+	} while (chunkOffset != chunkHeader->size);
+
+	return true;
 }
 
 static bool processChunkData(IffParseContext* parseContext, const IffParseRules* rules, const IffChunkHeader* chunkHeader)
 {
-	if (!(parseContext->chunkBuffer = malloc(chunkHeader->size)))
+	if (!parseContext->memory && rules->streamWindowSize)
+	{
+		const IffChunkHandler* chunkHandler = findChunkHandler(rules, chunkHeader->id);
+		if (chunkHandler && chunkHandler->streamFunc)
+			return streamChunkData(parseContext, rules, chunkHandler, chunkHeader);
+	}
+
+	// Hand the handler a pointer straight into the image, or into the read-ahead block, when
+	//  the whole chunk is there
+	void* chunkData = borrowBytesFromStream(parseContext, rules, chunkHeader->size);
+	if (chunkData)
+		return invokeChunkHandler(parseContext, rules, chunkHeader->id, chunkData, chunkHeader->size, false);
+
+	if (chunkHeader->size > MaxBufferedIffChunkSize)
 	{
 		char buf[1024];
-		sprintf(buf, "Unable to allocate %u bytes", chunkHeader->size);
-		rules->errorFunc(buf);
+		sprintf(buf, "Chunk of %u bytes is too large to be loaded in one piece", chunkHeader->size);
+		reportError(parseContext, rules, buf);
 		return false;
 	}
 
-#ifdef DEBUG_IFF_PARSER
-	printf("DEBUG_IFF_PARSER: Reading chunk data from file\n");
-#endif
+	TimerTicks allocateStart = startChunkTiming(rules);
+	if (!(parseContext->chunkBuffer = allocateMemory(rules->allocator, chunkHeader->size)))
+	{
+		char buf[1024];
+		sprintf(buf, "Unable to allocate %u bytes", chunkHeader->size);
+		reportError(parseContext, rules, buf);
+		return false;
+	}
+	stopChunkTiming(rules, &parseContext->chunkTiming.allocateTicks, allocateStart);
 
 	if (!readBytesFromStream(parseContext, rules, parseContext->chunkBuffer, chunkHeader->size))
 		return false;
@@ -158,8 +338,10 @@ static bool processChunkData(IffParseContext* parseContext, const IffParseRules*
 	if (!invokeChunkHandler(parseContext, rules, chunkHeader->id, parseContext->chunkBuffer, chunkHeader->size, false))
 		return false;
 	
-	free(parseContext->chunkBuffer);
+	allocateStart = startChunkTiming(rules);
+	releaseMemory(rules->allocator, parseContext->chunkBuffer);
 	parseContext->chunkBuffer = 0;
+	stopChunkTiming(rules, &parseContext->chunkTiming.allocateTicks, allocateStart);
 	
 	return true;
 }
@@ -168,10 +350,6 @@ static bool processChunkPad(IffParseContext* parseContext, const IffParseRules*
 {
 	if ((chunkHeader->size & 1) && parseContext->compositeBytesLeft)
 	{
-#ifdef DEBUG_IFF_PARSER
-	printf("DEBUG_IFF_PARSER: Skipping pad byte after chunk\n");
-#endif
-
 		char c;
 		if (!readBytesFromStream(parseContext, rules, &c, sizeof c))
 			return false;
@@ -185,80 +363,231 @@ static bool processChunks(IffParseContext* parseContext, const IffParseRules* ru
 	while (parseContext->compositeBytesLeft)
 	{
 		IffChunkHeader chunkHeader;
-		
-		if (!processChunkHeader(parseContext, rules, &chunkHeader)
-			|| !processChunkData(parseContext, rules, &chunkHeader)
-			|| !processChunkPad(parseContext, rules, &chunkHeader))
+
+		memset(&parseContext->chunkTiming, 0, sizeof parseContext->chunkTiming);
+		parseContext->chunkTiming.fileOffset = parseContext->fileOffset;
+
+		if (!processChunkHeader(parseContext, rules, &chunkHeader))
+			return false;
+
+		beginChunkEvent(parseContext, rules, chunkHeader.id, chunkHeader.size);
+
+		bool result = processChunkData(parseContext, rules, &chunkHeader)
+			&& processChunkPad(parseContext, rules, &chunkHeader);
+
+		endChunkEvent(parseContext, rules, result);
+		if (!result)
 			return false;
+
+		parseContext->location.chunkId = 0;
 	}
 	
 	return true;
 }
 
+static bool processComposite(IffParseContext* parseContext, const IffParseRules* rules, const IffHeader* iffHeader)
+{
+	if (!validateIffHeader(iffHeader))
+	{
+		reportError(parseContext, rules, "Invalid IFF header");
+		return false;
+	}
+
+	parseContext->compositeBytesLeft = iffHeader->compositeSize - 4;
+
+	// The FORM header is reported as a chunk of its own, which also covers opening the file
+	//  and the handler for the form type
+	beginChunkEvent(parseContext, rules, ID_FORM, iffHeader->compositeSize);
+	bool formTypeHandled = invokeChunkHandler(parseContext, rules, iffHeader->dataType, 0, 0, true);
+	endChunkEvent(parseContext, rules, formTypeHandled);
+
+	if (!formTypeHandled)
+	{
+		reportError(parseContext, rules, "Invalid IFF data type");
+		return false;
+	}
+
+	return processChunks(parseContext, rules);
+}
+
 bool parseIff(const char* fileName, const IffParseRules* rules)
 {
 	IffParseContext parseContext = { 0 };
 	IffHeader iffHeader;
-	
-#ifdef DEBUG_IFF_PARSER
-	printf("DEBUG_IFF_PARSER: Opening %s\n", fileName);
-#endif
 
+	TimerTicks readStart = startChunkTiming(rules);
 	parseContext.fileName = fileName;
-	parseContext.fileHandle = fopen(fileName, "rb");
 
-	if (!parseContext.fileHandle)
+	if (!(parseContext.readAhead = createReadAhead(rules->readBlockSize, rules->allocator)))
+	{
+		reportError(&parseContext, rules, "Unable to allocate read buffers");
+		return false;
+	}
+
+	if (!openReadAhead(parseContext.readAhead, fileName))
 	{
 		char buf[1024];
 		sprintf(buf, "Unable to open file");
-		rules->errorFunc(buf);
+		reportError(&parseContext, rules, buf);
+		cleanup(&parseContext, rules);
 		return false;
 	}
 
-#ifdef DEBUG_IFF_PARSER
-	printf("DEBUG_IFF_PARSER: Reading IFF header from file\n");
-#endif
+	if (!readReadAhead(parseContext.readAhead, &iffHeader, sizeof iffHeader))
+	{
+		char buf[1024];
+		sprintf(buf, "Unable to read %d bytes", (int) sizeof iffHeader);
+		reportError(&parseContext, rules, buf);
+		cleanup(&parseContext, rules);
+		return false;
+	}
+
+	stopChunkTiming(rules, &parseContext.chunkTiming.readTicks, readStart);
+
+	decodeIffHeader(&iffHeader);
+	parseContext.fileOffset = sizeof iffHeader;
+
+	bool result = processComposite(&parseContext, rules, &iffHeader);
 
-	if (fread(&iffHeader, sizeof iffHeader, 1, parseContext.fileHandle) != 1)
+	cleanup(&parseContext, rules);
+	
+	return result;
+}
+
+static bool parseIffMemoryOfFile(const char* fileName, const void* data, size_t size, const IffParseRules* rules)
+{
+	IffParseContext parseContext = { 0 };
+	IffHeader iffHeader;
+
+	parseContext.fileName = fileName;
+
+	if (size < sizeof iffHeader)
 	{
 		char buf[1024];
 		sprintf(buf, "Unable to read %d bytes", (int) sizeof iffHeader);
-		rules->errorFunc(buf);
-		cleanup(&parseContext);
+		reportError(&parseContext, rules, buf);
 		return false;
 	}
 
-	if (!validateIffHeader(&iffHeader))
+	memcpy(&iffHeader, data, sizeof iffHeader);
+	decodeIffHeader(&iffHeader);
+
+	if (iffHeader.compositeSize > size - 8)
 	{
-		rules->errorFunc("Invalid IFF header");
-		cleanup(&parseContext);
+		reportError(&parseContext, rules, "IFF file is truncated");
 		return false;
 	}
 
-	parseContext.compositeBytesLeft = iffHeader.compositeSize - 4;
+	parseContext.memory = (const uint8_t*) data + sizeof iffHeader;
+	parseContext.memoryEnd = (const uint8_t*) data + size;
+	parseContext.fileOffset = sizeof iffHeader;
+
+	return processComposite(&parseContext, rules, &iffHeader);
+}
 
-	if (!invokeChunkHandler(&parseContext, rules, iffHeader.dataType, 0, 0, true))
+bool parseIffMemory(const void* data, size_t size, const IffParseRules* rules)
+{
+	return parseIffMemoryOfFile(0, data, size, rules);
+}
+
+#ifdef AMIGA
+
+bool parseIffMapped(const char* fileName, const IffParseRules* rules)
+{
+	// There is no mmap() on AmigaOS; read the whole file in one go instead, so that
+	//  the chunks are handled in place just like with a mapping. DOS is called directly
+	//  rather than through stdio, so that this also works on a process started by startThread().
+
+	BPTR fileHandle = Open((STRPTR) fileName, MODE_OLDFILE);
+	if (!fileHandle)
 	{
-		rules->errorFunc("Invalid IFF data type");
-		cleanup(&parseContext);
+		reportFileError(fileName, rules, "Unable to open file");
 		return false;
 	}
 
-#ifdef DEBUG_IFF_PARSER
-	printf("DEBUG_IFF_PARSER: Processing all chunks in file\n");
-#endif
+	// Seek() returns the position from before the seek
+	LONG fileSize = -1;
+	if (Seek(fileHandle, 0, OFFSET_END) != -1)
+		fileSize = Seek(fileHandle, 0, OFFSET_BEGINNING);
 
-	bool result = processChunks(&parseContext, rules);
-	
-#ifdef DEBUG_IFF_PARSER
-	printf("DEBUG_IFF_PARSER: Chunk processsing %s\n", result ? "completed successfully" : "failed");
-#endif
+	if (fileSize < 0)
+	{
+		reportFileError(fileName, rules, "Unable to determine file size");
+		Close(fileHandle);
+		return false;
+	}
 
-#ifdef DEBUG_IFF_PARSER
-	printf("DEBUG_IFF_PARSER: Cleaning up resources\n");
-#endif
+	void* fileData = allocateMemory(rules->allocator, fileSize ? fileSize : 1);
+	if (!fileData)
+	{
+		char buf[1024];
+		sprintf(buf, "Unable to allocate %u bytes", (uint) fileSize);
+		reportFileError(fileName, rules, buf);
+		Close(fileHandle);
+		return false;
+	}
+
+	if (fileSize && Read(fileHandle, fileData, fileSize) != fileSize)
+	{
+		char buf[1024];
+		sprintf(buf, "Unable to read %d bytes", (int) fileSize);
+		reportFileError(fileName, rules, buf);
+		releaseMemory(rules->allocator, fileData);
+		Close(fileHandle);
+		return false;
+	}
+
+	Close(fileHandle);
+
+	bool result = parseIffMemoryOfFile(fileName, fileData, fileSize, rules);
+
+	releaseMemory(rules->allocator, fileData);
 
-	cleanup(&parseContext);
-	
 	return result;
 }
+
+#else
+
+bool parseIffMapped(const char* fileName, const IffParseRules* rules)
+{
+	int fileDescriptor = open(fileName, O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		reportFileError(fileName, rules, "Unable to open file");
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat))
+	{
+		reportFileError(fileName, rules, "Unable to determine file size");
+		close(fileDescriptor);
+		return false;
+	}
+
+	size_t fileSize = (size_t) fileStat.st_size;
+
+	// mmap() refuses empty mappings; let parseIffMemory() report the short file
+	if (!fileSize)
+	{
+		close(fileDescriptor);
+		return parseIffMemoryOfFile(fileName, "", 0, rules);
+	}
+
+	void* fileData = mmap(0, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	close(fileDescriptor);
+
+	if (fileData == MAP_FAILED)
+	{
+		reportFileError(fileName, rules, "Unable to map file into memory");
+		return false;
+	}
+
+	bool result = parseIffMemoryOfFile(fileName, fileData, fileSize, rules);
+
+	munmap(fileData, fileSize);
+
+	return result;
+}
+
+#endif
@@ -3,24 +3,86 @@
 #define PARSEIFF_H
 
 #include "Types.h"
+#include "Allocator.h"
+#include "Timer.h"
+
+#include <stddef.h>
 
 typedef bool (*IffChunkHandlerFunc)(void* state, void* buffer, unsigned int size);
 
-typedef void (*IffErrorFunc)(const char* message);
+// Streaming chunk handlers are fed a chunk in consecutive windows; chunkOffset is the
+//  position of the window within the chunk, and the final window ends at chunkSize
+typedef bool (*IffChunkStreamFunc)(void* state, void* buffer, unsigned int size, uint32_t chunkOffset, uint32_t chunkSize);
+
+// Where a problem was found: fileName is 0 when parsing from memory, and chunkId is 0 when the
+//  problem is not inside any chunk. fileOffset is the start of the chunk's header within the file
+//  when chunkId is set, and otherwise the position the parser had reached.
+typedef struct
+{
+	const char* fileName;
+	uint32_t chunkId;
+	uint32_t fileOffset;
+} IffErrorLocation;
+
+typedef void (*IffErrorFunc)(void* context, const IffErrorLocation* location, const char* message);
+
+// Describes a location for humans, like "image.iff, BODY chunk at offset 120"
+void formatIffErrorLocation(char* buffer, size_t bufferSize, const IffErrorLocation* location);
+
+// What one chunk cost to parse, in timer ticks. The FORM header is reported as a chunk of its own,
+//  which also covers opening the file and the handler for the form type. parseIffMapped() maps or
+//  reads the whole file before parsing starts, and that is not counted.
+typedef struct
+{
+	uint32_t id;
+	uint32_t size;
+	uint32_t fileOffset;	// Of the chunk header
+	TimerTicks readTicks;	// Reading header, data and pad byte; next to nothing when parsing from memory
+	TimerTicks allocateTicks;	// Allocating and releasing the chunk buffer
+	TimerTicks handlerTicks;	// Inside the chunk handler; for streamed chunks, summed over all windows
+	bool handled;	// false when no handler wanted the chunk, and it was passed over
+	bool succeeded;
+} IffChunkTiming;
+
+// Called once the chunk header has been read, and once the chunk has been dealt with; the end
+//  is also reported for chunks whose handling failed
+typedef void (*IffChunkBeginFunc)(void* context, uint32_t id, uint32_t size, uint32_t fileOffset);
+typedef void (*IffChunkEndFunc)(void* context, const IffChunkTiming* timing);
 
 typedef struct
 {
 	uint32_t id;
 	IffChunkHandlerFunc handlerFunc;
+	IffChunkStreamFunc streamFunc;
 } IffChunkHandler;
 
 typedef struct
 {
 	IffErrorFunc errorFunc;
-	IffChunkHandler* chunkHandlers;
+	void* errorContext;
+	const IffChunkHandler* chunkHandlers;
 	void* chunkHandlerState;
+	uint streamWindowSize;	// When nonzero, parseIff() feeds chunks with a streamFunc in windows of this size
+	uint readBlockSize;	// parseIff() reads the file ahead in two blocks of this size; 0 means DefaultReadAheadBlockSize
+	IffErrorLocation* handlerLocation;	// When set, kept up to date with the chunk being handled, so handlers can report errors with it
+	const Allocator* allocator;	// Chunk and stream buffers come from here; 0 means the C heap
+
+	// Optional instrumentation, called on the parsing thread. Chunks are only timed when
+	//  chunkEndFunc is set, and then initTimer() must have succeeded.
+	IffChunkBeginFunc chunkBeginFunc;
+	IffChunkEndFunc chunkEndFunc;
+	void* chunkEventContext;
 } IffParseRules;
 
+// All parsing state lives on the stack of the parse call and in the rules, so any number of
+//  files may be parsed at the same time on different threads, as long as each parse has its own
+//  chunkHandlerState and handlerLocation. errorFunc is called on the thread which is parsing.
+
+enum { DefaultIffStreamWindowSize = 64 * 1024 };
+
+// Chunks which are handed to handlerFunc in one piece must not be larger than this
+enum { MaxBufferedIffChunkSize = 16 * 1024 * 1024 };
+
 enum
 {
 	ID_FORM = 'FORM',
@@ -33,6 +95,21 @@ enum
 	ID_CRNG = 'CRNG',
 };
 
+// Reads the file front to back; while the chunk handlers work, the next block of the file is
+//  already being read. Chunks which lie within one block are handed over in place, without a copy.
 bool parseIff(const char* fileName, const IffParseRules* rules);
 
+// IFF data is big-endian; these read it correctly regardless of host byte order
+uint16_t readIffUint16(const void* source);
+uint32_t readIffUint32(const void* source);
+
+// Parse an IFF image which already resides in memory. Chunk handlers receive pointers
+//  directly into the image instead of into per-chunk copies, so they must treat the
+//  buffer as read-only and must not keep it after parsing has finished.
+bool parseIffMemory(const void* data, size_t size, const IffParseRules* rules);
+
+// Parse an IFF file by mapping it into memory (mmap on Linux; a single read of the
+//  whole file into one buffer on AmigaOS), then handling it like parseIffMemory().
+bool parseIffMapped(const char* fileName, const IffParseRules* rules);
+
 #endif
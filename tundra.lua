@@ -60,11 +60,25 @@ local amiga_win32 = {
 	},
 }
 
+local linux = {
+	Inherit = common,
+	Env = {
+		LIBS = { "pthread" },
+		CCOPTS = {
+			"-O2",
+			"-std=gnu99",
+			"-Wall",
+			"-Wno-multichar", -- IFF chunk ids are multi-character constants
+		},
+	},
+}
+
 Build {
 	Units = "units.lua",
 	Configs = {
 		Config { Name = "amiga-vbccmac", Inherit = amiga_osx, Tools = { "vbcc" }, Virtual = true, },
 		Config { Name = "amiga-vbccwin", Inherit = amiga_win32, DefaultOnHost = { "windows" }, Tools = { "vbcc" }, },
+		Config { Name = "linux-gcc", Inherit = linux, DefaultOnHost = { "linux" }, Tools = { "gcc" }, },
 		Config { 
 			Name = "amiga-vbccosx",
 			Inherit = common,
@@ -2,7 +2,11 @@
 Program {
 	Name = "TestIffParser",
 	Sources = {
+		"Allocator.c",
 		"parseIff.c",
+		"ReadAhead.c",
+		"Timer.c",
+		"IffParseStats.c",
 		"TestIffParser.c",
 	},
 }
@@ -10,8 +14,16 @@ Program {
 Program {
 	Name = "TestIffImageLoader",
 	Sources = {
+		"Allocator.c",
 		"parseIff.c",
+		"ReadAhead.c",
+		"Timer.c",
+		"ByteRun1.c",
 		"Ilbm.c",
+		"ChunkyToPlanar.c",
+		"PlanarToChunky.c",
+		"Thread.c",
+		"IffParseStats.c",
 		"TestIffImageLoader.c",
 	},
 }
@@ -19,13 +31,111 @@ Program {
 Program {
 	Name = "SuperCycler",
 	Sources = {
+		"Allocator.c",
 		"parseIff.c",
+		"ReadAhead.c",
+		"ByteRun1.c",
 		"Ilbm.c",
-		"ScreenAndInput.c",
+		"ChunkyToPlanar.c",
+		"PlanarToChunky.c",
+		"Thread.c",
+		"PaletteAnimation.c",
+		"FileList.c",
+		"FileWatch.c",
+		"Timer.c",
+		"FrameStats.c",
+		{ "ScreenAndInput.c"; Config = "amiga-*" },
+		{ "ScreenAndInputHeadless.c"; Config = "linux-*" },
+		{ "PaletteRepaint.c"; Config = "linux-*" },
 		"SuperCycler.c",
 	},
 }
 
+Program {
+	Name = "CycleExporter",
+	Sources = {
+		"Allocator.c",
+		"parseIff.c",
+		"ReadAhead.c",
+		"Timer.c",
+		"ByteRun1.c",
+		"Ilbm.c",
+		"ChunkyToPlanar.c",
+		"PlanarToChunky.c",
+		"Thread.c",
+		"PaletteAnimation.c",
+		"CycleExporter.c",
+	},
+}
+
+Program {
+	Name = "BenchmarkByteRun1",
+	Sources = {
+		"Allocator.c",
+		"parseIff.c",
+		"ReadAhead.c",
+		"Thread.c",
+		"ByteRun1.c",
+		"FileList.c",
+		"Timer.c",
+		"BenchmarkByteRun1.c",
+	},
+}
+
+Program {
+	Name = "BenchmarkBodyDecode",
+	Sources = {
+		"Allocator.c",
+		"parseIff.c",
+		"ReadAhead.c",
+		"ByteRun1.c",
+		"Ilbm.c",
+		"ChunkyToPlanar.c",
+		"PlanarToChunky.c",
+		"Thread.c",
+		"FileList.c",
+		"Timer.c",
+		"BenchmarkBodyDecode.c",
+	},
+}
+
+Program {
+	Name = "BenchmarkLoadAndAnimate",
+	Sources = {
+		"Allocator.c",
+		"parseIff.c",
+		"ReadAhead.c",
+		"ByteRun1.c",
+		"Ilbm.c",
+		"ChunkyToPlanar.c",
+		"PlanarToChunky.c",
+		"Thread.c",
+		"PaletteAnimation.c",
+		"FileList.c",
+		"Timer.c",
+		"Benchmark.c",
+		"SyntheticImage.c",
+		{ "ScreenAndInput.c"; Config = "amiga-*" },
+		{ "ScreenAndInputHeadless.c"; Config = "linux-*" },
+		{ "PaletteRepaint.c"; Config = "linux-*" },
+		"BenchmarkLoadAndAnimate.c",
+	},
+}
+
+Program {
+	Name = "GenerateTestImage",
+	Sources = {
+		"ChunkyToPlanar.c",
+		"SyntheticImage.c",
+		"GenerateTestImage.c",
+	},
+}
+
 Default "TestIffParser"
 Default "TestIffImageLoader"
 Default "SuperCycler"
+Default "CycleExporter"
+Default "BenchmarkByteRun1"
+Default "BenchmarkBodyDecode"
+Default "BenchmarkLoadAndAnimate"
+Default "GenerateTestImage"